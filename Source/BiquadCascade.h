@@ -0,0 +1,201 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+    A fused cascade of second order sections that runs every active section
+    per sample, instead of making one pass over the buffer per filter.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Plain copy of a second order section (normalised so that a0 == 1), laid out
+// like juce::dsp::IIR::Coefficients stores it. Always designed in double, the
+// float path rounds when the coefficients are loaded into a cascade.
+struct BiquadCoefficients
+{
+    double b0 { 1.0 }, b1 { 0.0 }, b2 { 0.0 }, a1 { 0.0 }, a2 { 0.0 };
+};
+
+// SampleType can either be a float or a juce::dsp::SIMDRegister, in which case
+// every lane is filtered with the same coefficients.
+//
+// Coefficients and states are kept as separate arrays indexed by section. The
+// sections that are active get gathered into contiguous arrays once per block,
+// so the inner loop only touches what it needs and the intermediate value of
+// each sample stays in a register while it travels through the cascade.
+//
+// The inner loop is instantiated for every possible number of active sections,
+// so that it can be fully unrolled. Each block dispatches once, through a
+// table, to the instantiation that matches.
+template<typename SampleType, int MaxSections>
+struct BiquadCascade
+{
+    using NumericType = typename juce::dsp::SampleTypeHelpers::ElementType<SampleType>::Type;
+    
+    BiquadCascade()
+    {
+        for (int section = 0; section < MaxSections; section++)
+        {
+            setCoefficients(section, BiquadCoefficients());
+        }
+        
+        active.fill(false);
+        reset();
+    }
+    
+    void reset()
+    {
+        s1.fill(SampleType { 0 });
+        s2.fill(SampleType { 0 });
+    }
+    
+    void setCoefficients(int section, const BiquadCoefficients& coefficients)
+    {
+        jassert(juce::isPositiveAndBelow(section, MaxSections));
+        
+        b0[section] = static_cast<NumericType>(coefficients.b0);
+        b1[section] = static_cast<NumericType>(coefficients.b1);
+        b2[section] = static_cast<NumericType>(coefficients.b2);
+        a1[section] = static_cast<NumericType>(coefficients.a1);
+        a2[section] = static_cast<NumericType>(coefficients.a2);
+    }
+    
+    void setActive(int section, bool shouldBeActive)
+    {
+        jassert(juce::isPositiveAndBelow(section, MaxSections));
+        
+        if (active[section] == shouldBeActive)
+        {
+            return;
+        }
+        
+        // A section that comes back shouldn't ring out whatever it held before.
+        if (shouldBeActive)
+        {
+            s1[section] = SampleType { 0 };
+            s2[section] = SampleType { 0 };
+        }
+        
+        active[section] = shouldBeActive;
+        
+        numActiveSections = 0;
+        
+        for (int i = 0; i < MaxSections; i++)
+        {
+            if (active[i])
+            {
+                activeSections[numActiveSections++] = i;
+            }
+        }
+    }
+    
+    bool isActive(int section) const { return active[section]; }
+    int getNumActiveSections() const { return numActiveSections; }
+    
+    // True once no lane of any active section holds more than threshold, i.e.
+    // the cascade would only output (close to) silence for silent input.
+    bool hasDecayed(NumericType threshold) const noexcept
+    {
+        constexpr auto numLanes = sizeof(SampleType) / sizeof(NumericType);
+        
+        for (int i = 0; i < numActiveSections; i++)
+        {
+            auto section = activeSections[i];
+            auto* state1 = reinterpret_cast<const NumericType*>(&s1[section]);
+            auto* state2 = reinterpret_cast<const NumericType*>(&s2[section]);
+            
+            for (size_t lane = 0; lane < numLanes; lane++)
+            {
+                if (std::abs(state1[lane]) > threshold || std::abs(state2[lane]) > threshold)
+                {
+                    return false;
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    // Transposed direct form II, same as juce::dsp::IIR::Filter.
+    void process(SampleType* samples, size_t numSamples) noexcept
+    {
+        static constexpr auto processFunctions = makeProcessFunctions(std::make_index_sequence<MaxSections + 1>());
+        
+        (this->*processFunctions[(size_t) numActiveSections])(samples, numSamples);
+    }
+    
+private:
+    std::array<NumericType, MaxSections> b0, b1, b2, a1, a2;
+    std::array<SampleType, MaxSections> s1, s2;
+    
+    std::array<bool, MaxSections> active;
+    std::array<int, MaxSections> activeSections;
+    int numActiveSections = 0;
+    
+    template<int NumSections>
+    void processSections(SampleType* samples, size_t numSamples) noexcept
+    {
+        if constexpr (NumSections > 0)
+        {
+            std::array<NumericType, NumSections> c0, c1, c2, c3, c4;
+            std::array<SampleType, NumSections> z1, z2;
+            
+            // Gather.
+            for (int i = 0; i < NumSections; i++)
+            {
+                auto section = activeSections[i];
+                
+                c0[i] = b0[section];
+                c1[i] = b1[section];
+                c2[i] = b2[section];
+                c3[i] = a1[section];
+                c4[i] = a2[section];
+                z1[i] = s1[section];
+                z2[i] = s2[section];
+            }
+            
+            for (size_t n = 0; n < numSamples; n++)
+            {
+                auto x = samples[n];
+                
+                for (int i = 0; i < NumSections; i++)
+                {
+                    auto y = (x * c0[i]) + z1[i];
+                    z1[i] = (x * c1[i]) - (y * c3[i]) + z2[i];
+                    z2[i] = (x * c2[i]) - (y * c4[i]);
+                    x = y;
+                }
+                
+                samples[n] = x;
+            }
+            
+            // Scatter.
+            for (int i = 0; i < NumSections; i++)
+            {
+                auto section = activeSections[i];
+                
+                juce::dsp::util::snapToZero(z1[i]);
+                juce::dsp::util::snapToZero(z2[i]);
+                
+                s1[section] = z1[i];
+                s2[section] = z2[i];
+            }
+        }
+        else
+        {
+            juce::ignoreUnused(samples, numSamples);
+        }
+    }
+    
+    using ProcessFunction = void (BiquadCascade::*)(SampleType*, size_t) noexcept;
+    
+    template<size_t... NumSections>
+    static constexpr std::array<ProcessFunction, sizeof...(NumSections)> makeProcessFunctions(std::index_sequence<NumSections...>)
+    {
+        return { { &BiquadCascade::processSections<(int) NumSections>... } };
+    }
+};
@@ -0,0 +1,338 @@
+/*
+  ==============================================================================
+
+    BiquadDesign.h
+    Allocation free versions of the juce::dsp designs used by the EQ, so that
+    coefficients can be computed on the audio thread while parameters ramp.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BiquadCascade.h"
+
+inline BiquadCoefficients makeBiquad(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+    const auto a0Inverse = 1.0 / a0;
+    
+    BiquadCoefficients coefficients;
+    coefficients.b0 = b0 * a0Inverse;
+    coefficients.b1 = b1 * a0Inverse;
+    coefficients.b2 = b2 * a0Inverse;
+    coefficients.a1 = a1 * a0Inverse;
+    coefficients.a2 = a2 * a0Inverse;
+    
+    return coefficients;
+}
+
+// Same as juce::dsp::IIR::Coefficients::makePeakFilter.
+inline BiquadCoefficients makePeakBiquad(double sampleRate, double frequency, double quality, double gainFactor)
+{
+    jassert(sampleRate > 0.0);
+    jassert(frequency > 0.0 && frequency <= sampleRate * 0.5);
+    jassert(quality > 0.0);
+    
+    const auto A = std::sqrt(juce::jmax(0.0, gainFactor));
+    const auto omega = (juce::MathConstants<double>::twoPi * juce::jmax(frequency, 2.0)) / sampleRate;
+    const auto alpha = std::sin(omega) / (quality * 2.0);
+    const auto c2 = -2.0 * std::cos(omega);
+    const auto alphaTimesA = alpha * A;
+    const auto alphaOverA = alpha / A;
+    
+    return makeBiquad(1.0 + alphaTimesA, c2, 1.0 - alphaTimesA, 1.0 + alphaOverA, c2, 1.0 - alphaOverA);
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeLowPass.
+inline BiquadCoefficients makeLowPassBiquad(double sampleRate, double frequency, double quality)
+{
+    const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ = 1.0 / quality;
+    const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+    
+    return makeBiquad(c1, c1 * 2.0, c1, 1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - invQ * n + nSquared));
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeHighPass.
+inline BiquadCoefficients makeHighPassBiquad(double sampleRate, double frequency, double quality)
+{
+    const auto n = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ = 1.0 / quality;
+    const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+    
+    return makeBiquad(c1, c1 * -2.0, c1, 1.0, c1 * 2.0 * (nSquared - 1.0), c1 * (1.0 - invQ * n + nSquared));
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeLowShelf.
+inline BiquadCoefficients makeLowShelfBiquad(double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A = std::sqrt(juce::jmax(0.0, gainFactor));
+    const auto aMinus1 = A - 1.0;
+    const auto aPlus1 = A + 1.0;
+    const auto omega = (juce::MathConstants<double>::twoPi * juce::jmax(frequency, 2.0)) / sampleRate;
+    const auto cosOmega = std::cos(omega);
+    const auto beta = std::sin(omega) * std::sqrt(A) / quality;
+    const auto aMinus1TimesCos = aMinus1 * cosOmega;
+    
+    return makeBiquad(A * (aPlus1 - aMinus1TimesCos + beta),
+                      A * 2.0 * (aMinus1 - aPlus1 * cosOmega),
+                      A * (aPlus1 - aMinus1TimesCos - beta),
+                      aPlus1 + aMinus1TimesCos + beta,
+                      -2.0 * (aMinus1 + aPlus1 * cosOmega),
+                      aPlus1 + aMinus1TimesCos - beta);
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeHighShelf.
+inline BiquadCoefficients makeHighShelfBiquad(double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A = std::sqrt(juce::jmax(0.0, gainFactor));
+    const auto aMinus1 = A - 1.0;
+    const auto aPlus1 = A + 1.0;
+    const auto omega = (juce::MathConstants<double>::twoPi * juce::jmax(frequency, 2.0)) / sampleRate;
+    const auto cosOmega = std::cos(omega);
+    const auto beta = std::sin(omega) * std::sqrt(A) / quality;
+    const auto aMinus1TimesCos = aMinus1 * cosOmega;
+    
+    return makeBiquad(A * (aPlus1 + aMinus1TimesCos + beta),
+                      A * -2.0 * (aMinus1 + aPlus1 * cosOmega),
+                      A * (aPlus1 + aMinus1TimesCos - beta),
+                      aPlus1 - aMinus1TimesCos + beta,
+                      2.0 * (aMinus1 - aPlus1 * cosOmega),
+                      aPlus1 - aMinus1TimesCos - beta);
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeNotch.
+inline BiquadCoefficients makeNotchBiquad(double sampleRate, double frequency, double quality)
+{
+    const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ = 1.0 / quality;
+    const auto c1 = 1.0 / (1.0 + n * invQ + nSquared);
+    const auto b0 = c1 * (1.0 + nSquared);
+    const auto b1 = 2.0 * c1 * (1.0 - nSquared);
+    
+    return makeBiquad(b0, b1, b0, 1.0, b1, c1 * (1.0 - n * invQ + nSquared));
+}
+
+// Same as juce::dsp::IIR::Coefficients::makeBandPass.
+inline BiquadCoefficients makeBandPassBiquad(double sampleRate, double frequency, double quality)
+{
+    const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ = 1.0 / quality;
+    const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+    
+    return makeBiquad(c1 * n * invQ, 0.0, -c1 * n * invQ, 1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - invQ * n + nSquared));
+}
+
+// A high shelf that is turned down by half its gain, so that the spectrum
+// pivots around the frequency: gainFactor is the difference between the top
+// and the bottom of the spectrum.
+inline BiquadCoefficients makeTiltBiquad(double sampleRate, double frequency, double quality, double gainFactor)
+{
+    auto coefficients = makeHighShelfBiquad(sampleRate, frequency, quality, gainFactor);
+    const auto pivotGain = 1.0 / std::sqrt(juce::jmax(1.0e-12, gainFactor));
+    
+    coefficients.b0 *= pivotGain;
+    coefficients.b1 *= pivotGain;
+    coefficients.b2 *= pivotGain;
+    
+    return coefficients;
+}
+
+// The shapes a parametric band can take. New types only ever get appended,
+// they are stored as a choice parameter.
+enum BandType
+{
+    PeakBand,
+    LowShelfBand,
+    HighShelfBand,
+    NotchBand,
+    BandPassBand,
+    TiltBand,
+    NumBandTypes
+};
+
+// Notch and band pass ignore the gain.
+inline BiquadCoefficients makeBandBiquad(BandType type, double sampleRate, double frequency, double quality, double gainFactor)
+{
+    switch (type)
+    {
+        case LowShelfBand:  return makeLowShelfBiquad(sampleRate, frequency, quality, gainFactor);
+        case HighShelfBand: return makeHighShelfBiquad(sampleRate, frequency, quality, gainFactor);
+        case NotchBand:     return makeNotchBiquad(sampleRate, frequency, quality);
+        case BandPassBand:  return makeBandPassBiquad(sampleRate, frequency, quality);
+        case TiltBand:      return makeTiltBiquad(sampleRate, frequency, quality, gainFactor);
+        case PeakBand:
+        case NumBandTypes:
+        default:            return makePeakBiquad(sampleRate, frequency, quality, gainFactor);
+    }
+}
+
+// A band that only changes the gain doesn't do anything at 0 dB.
+constexpr bool bandTypeUsesGain(BandType type)
+{
+    return type != NotchBand && type != BandPassBand;
+}
+
+// Cuts go up to 96 dB/oct, i.e. order 16 or eight second order sections.
+constexpr int MaxCutOrder = 16;
+constexpr int MaxCutSections = MaxCutOrder / 2;
+
+enum CutType
+{
+    Butterworth,
+    LinkwitzRiley,
+    NumCutTypes
+};
+
+// The analog prototypes of every even order cut, as the quality factor of
+// each second order section. Computed at compile time.
+struct CutPrototypes
+{
+    using SectionQualities = std::array<double, MaxCutSections>;
+    
+    std::array<SectionQualities, MaxCutOrder + 1> butterworth {}, linkwitzRiley {};
+    
+    static constexpr double cosine(double x)
+    {
+        // Taylor series, plenty accurate for 0 <= x <= pi.
+        auto term = 1.0, sum = 1.0;
+        
+        for (int n = 1; n < 24; n++)
+        {
+            term *= -x * x / ((2.0 * n - 1.0) * (2.0 * n));
+            sum += term;
+        }
+        
+        return sum;
+    }
+    
+    // Pole pair i of a Butterworth filter of any order sits at
+    // (2i + 1 + order % 2) * pi / (2 * order) from the negative real axis.
+    // An odd order also has a real pole, which isn't counted here.
+    static constexpr double getPolePairQuality(int order, int pair)
+    {
+        const auto angle = (2.0 * pair + 1.0 + order % 2) * juce::MathConstants<double>::pi / (2.0 * order);
+        return 1.0 / (2.0 * cosine(angle));
+    }
+    
+    constexpr CutPrototypes()
+    {
+        for (int order = 2; order <= MaxCutOrder; order += 2)
+        {
+            // Same section order as juce::dsp::FilterDesign.
+            for (int i = 0; i < order / 2; i++)
+            {
+                butterworth[order][i] = getPolePairQuality(order, i);
+            }
+            
+            // A Linkwitz-Riley filter is a Butterworth filter of half the
+            // order twice. Doubling a real pole gives a critically damped
+            // section (Q = 0.5).
+            const auto halfOrder = order / 2;
+            auto section = 0;
+            
+            if (halfOrder % 2 != 0)
+            {
+                linkwitzRiley[order][section++] = 0.5;
+            }
+            
+            for (int pair = 0; pair < halfOrder / 2; pair++)
+            {
+                linkwitzRiley[order][section++] = getPolePairQuality(halfOrder, pair);
+                linkwitzRiley[order][section++] = getPolePairQuality(halfOrder, pair);
+            }
+        }
+    }
+};
+
+inline constexpr CutPrototypes cutPrototypes;
+
+static_assert(cutPrototypes.butterworth[2][0] > 0.7071 && cutPrototypes.butterworth[2][0] < 0.7072, "");
+static_assert(cutPrototypes.linkwitzRiley[6][1] > 0.9999 && cutPrototypes.linkwitzRiley[6][1] < 1.0001, "");
+
+// Quality of one section of an even order cut.
+constexpr double getCutSectionQuality(CutType type, int order, int section)
+{
+    return type == LinkwitzRiley ? cutPrototypes.linkwitzRiley[order][section]
+                                 : cutPrototypes.butterworth[order][section];
+}
+
+// Fills the first order / 2 sections. Butterworth cuts come out the same as
+// designIIR...HighOrderButterworthMethod.
+template<size_t NumSections>
+void designHighPass(std::array<BiquadCoefficients, NumSections>& sections, double sampleRate, double frequency, int order,
+                    CutType type = Butterworth)
+{
+    jassert(order % 2 == 0 && order <= MaxCutOrder && order / 2 <= (int) NumSections);
+    
+    for (int i = 0; i < order / 2; i++)
+    {
+        sections[i] = makeHighPassBiquad(sampleRate, frequency, getCutSectionQuality(type, order, i));
+    }
+}
+
+template<size_t NumSections>
+void designLowPass(std::array<BiquadCoefficients, NumSections>& sections, double sampleRate, double frequency, int order,
+                   CutType type = Butterworth)
+{
+    jassert(order % 2 == 0 && order <= MaxCutOrder && order / 2 <= (int) NumSections);
+    
+    for (int i = 0; i < order / 2; i++)
+    {
+        sections[i] = makeLowPassBiquad(sampleRate, frequency, getCutSectionQuality(type, order, i));
+    }
+}
+
+// Complex response of a section at the given frequency.
+inline std::complex<double> getBiquadResponseForFrequency(const BiquadCoefficients& coefficients, double frequency,
+                                                          double sampleRate)
+{
+    const auto omega = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+    const auto z1 = std::polar(1.0, -omega);
+    const auto z2 = z1 * z1;
+    
+    const auto numerator = coefficients.b0 + coefficients.b1 * z1 + coefficients.b2 * z2;
+    const auto denominator = 1.0 + coefficients.a1 * z1 + coefficients.a2 * z2;
+    
+    return numerator / denominator;
+}
+
+// Magnitude of a section at the given frequency, like
+// juce::dsp::IIR::Coefficients::getMagnitudeForFrequency.
+inline double getBiquadMagnitudeForFrequency(const BiquadCoefficients& coefficients, double frequency, double sampleRate)
+{
+    return std::abs(getBiquadResponseForFrequency(coefficients, frequency, sampleRate));
+}
+
+// Number of samples the impulse response of a section takes to decay by
+// decayDecibels, going by the radius of its slowest pole.
+inline double getBiquadDecayInSamples(const BiquadCoefficients& coefficients, double decayDecibels)
+{
+    // Poles are the roots of z^2 + a1 z + a2.
+    const auto discriminant = coefficients.a1 * coefficients.a1 - 4.0 * coefficients.a2;
+    
+    auto radius = 0.0;
+    
+    if (discriminant < 0.0)
+    {
+        radius = std::sqrt(coefficients.a2);
+    }
+    else
+    {
+        const auto root = std::sqrt(discriminant);
+        radius = juce::jmax(std::abs(-coefficients.a1 + root), std::abs(-coefficients.a1 - root)) * 0.5;
+    }
+    
+    jassert(radius < 1.0);
+    
+    if (radius <= 0.0 || radius >= 1.0)
+    {
+        return 0.0;
+    }
+    
+    return std::log(juce::Decibels::decibelsToGain(-std::abs(decayDecibels), -1000.0)) / std::log(radius);
+}
@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    CoefficientCache.cpp
+
+  ==============================================================================
+*/
+
+#include "CoefficientCache.h"
+#include "DynamicBand.h"
+
+CoefficientCache::CoefficientCache() :
+slots(new Slot[NumSlots])
+{
+}
+
+juce::uint64 CoefficientCache::Key::getHash() const noexcept
+{
+    // FNV-1a over the fields, followed by a final mix.
+    auto hash = (juce::uint64) 0xcbf29ce484222325ull;
+    
+    auto add = [&hash](juce::uint64 value)
+    {
+        hash ^= value;
+        hash *= 0x100000001b3ull;
+    };
+    
+    add(sampleRateBits);
+    add((juce::uint64) (juce::uint32) type);
+    add((juce::uint64) (juce::uint32) variant);
+    add((juce::uint64) (juce::uint32) order);
+    add((juce::uint64) (juce::uint32) frequency);
+    add((juce::uint64) (juce::uint32) gain);
+    add((juce::uint64) (juce::uint32) quality);
+    
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    
+    return hash;
+}
+
+bool CoefficientCache::makeKey(Key& key, FilterType type, int variant, double sampleRate, float frequency, int order,
+                               float gainDecibels, float quality)
+{
+    auto quantize = [](float value, float step, int& steps)
+    {
+        const auto rounded = std::round(value / step);
+        
+        if (std::abs(rounded * step - value) > step * 1.0e-3f)
+        {
+            return false;
+        }
+        
+        steps = (int) rounded;
+        return true;
+    };
+    
+    static_assert(sizeof(sampleRate) == sizeof(key.sampleRateBits), "");
+    std::memcpy(&key.sampleRateBits, &sampleRate, sizeof(sampleRate));
+    
+    key.type = type;
+    key.variant = variant;
+    key.order = order;
+    
+    return quantize(frequency, 1.f, key.frequency)
+        && quantize(gainDecibels, 0.5f, key.gain)
+        && quantize(quality, 0.05f, key.quality);
+}
+
+bool CoefficientCache::find(const Key& key, Sections& sections) const noexcept
+{
+    const auto start = (int) (key.getHash() % NumSlots);
+    
+    for (int probe = 0; probe < MaxProbes; probe++)
+    {
+        const auto& slot = slots[(start + probe) % NumSlots];
+        
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        
+        // Never written, so nothing further along the chain either.
+        if (sequence == 0)
+        {
+            return false;
+        }
+        
+        // Being rewritten.
+        if ((sequence & 1) != 0)
+        {
+            continue;
+        }
+        
+        const auto slotKey = slot.key;
+        
+        if (!(slotKey == key))
+        {
+            continue;
+        }
+        
+        sections = slot.sections;
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        // Rewritten while it was copied.
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+    
+    return false;
+}
+
+void CoefficientCache::insert(const Key& key, const Sections& sections) noexcept
+{
+    const juce::SpinLock::ScopedTryLockType tryLock(writeLock);
+    
+    if (!tryLock.isLocked())
+    {
+        return;
+    }
+    
+    const auto start = (int) (key.getHash() % NumSlots);
+    
+    // An empty slot or one with the same key if there is one, otherwise the
+    // first slot of the chain gets evicted.
+    auto* target = &slots[start];
+    
+    for (int probe = 0; probe < MaxProbes; probe++)
+    {
+        auto& slot = slots[(start + probe) % NumSlots];
+        
+        if (slot.sequence.load(std::memory_order_relaxed) == 0 || slot.key == key)
+        {
+            target = &slot;
+            break;
+        }
+    }
+    
+    const auto sequence = target->sequence.load(std::memory_order_relaxed);
+    
+    target->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    target->key = key;
+    target->sections = sections;
+    
+    target->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+template<typename DesignFunction>
+void CoefficientCache::getSections(Sections& sections, const Key& key, bool cacheable, bool countLookup,
+                                   DesignFunction&& design)
+{
+    if (cacheable && find(key, sections))
+    {
+        if (countLookup)
+        {
+            ++numHits;
+        }
+        
+        return;
+    }
+    
+    if (countLookup)
+    {
+        ++numMisses;
+    }
+    
+    design(sections);
+    
+    if (cacheable)
+    {
+        insert(key, sections);
+    }
+}
+
+BiquadCoefficients CoefficientCache::getBand(BandType type, double sampleRate, float frequency, float quality, float gainDecibels)
+{
+    return getBand(type, sampleRate, frequency, quality, gainDecibels, true);
+}
+
+BiquadCoefficients CoefficientCache::getBand(BandType type, double sampleRate, float frequency, float quality, float gainDecibels,
+                                             bool countLookup)
+{
+    Key key;
+    Sections sections;
+    
+    const auto cacheable = makeKey(key, Band, type, sampleRate, frequency, 2, gainDecibels, quality);
+    
+    getSections(sections, key, cacheable, countLookup, [&](Sections& s)
+    {
+        s[0] = makeBandBiquad(type, sampleRate, frequency, quality, juce::Decibels::decibelsToGain(gainDecibels));
+    });
+    
+    return sections[0];
+}
+
+BiquadCoefficients CoefficientCache::getDynamicBandPass(double sampleRate, float frequency, float quality, float gainDecibels)
+{
+    return getDynamicBandPass(sampleRate, frequency, quality, gainDecibels, true);
+}
+
+BiquadCoefficients CoefficientCache::getDynamicBandPass(double sampleRate, float frequency, float quality, float gainDecibels,
+                                                        bool countLookup)
+{
+    Key key;
+    Sections sections;
+    
+    const auto cacheable = makeKey(key, DynamicBandPass, 0, sampleRate, frequency, 2, gainDecibels, quality);
+    
+    getSections(sections, key, cacheable, countLookup, [&](Sections& s)
+    {
+        s[0] = makeDynamicBandPassBiquad(sampleRate, frequency, quality, juce::Decibels::decibelsToGain(gainDecibels));
+    });
+    
+    return sections[0];
+}
+
+template<typename DesignFunction>
+void CoefficientCache::getCut(Sections& sections, FilterType type, CutType cutType, double sampleRate, float frequency, int order,
+                              bool countLookup, DesignFunction&& design)
+{
+    Key key;
+    Sections cached;
+    
+    const auto cacheable = makeKey(key, type, cutType, sampleRate, frequency, order, 0.f, 0.f);
+    
+    getSections(cached, key, cacheable, countLookup, [&](Sections& s)
+    {
+        design(s, sampleRate, (double) frequency, order, cutType);
+    });
+    
+    // Sections past order / 2 are left alone, same as designing in place.
+    std::copy(cached.begin(), cached.begin() + juce::jmin(order / 2, MaxSections), sections.begin());
+}
+
+void CoefficientCache::getHighPass(Sections& sections, double sampleRate, float frequency, int order, CutType cutType)
+{
+    getCut(sections, HighPass, cutType, sampleRate, frequency, order, true,
+           [](Sections& s, double rate, double f, int o, CutType t) { designHighPass(s, rate, f, o, t); });
+}
+
+void CoefficientCache::getLowPass(Sections& sections, double sampleRate, float frequency, int order, CutType cutType)
+{
+    getCut(sections, LowPass, cutType, sampleRate, frequency, order, true,
+           [](Sections& s, double rate, double f, int o, CutType t) { designLowPass(s, rate, f, o, t); });
+}
+
+void CoefficientCache::prewarm(double sampleRate)
+{
+    static constexpr float thirdOctaves[] =
+    {
+        20.f, 25.f, 31.f, 40.f, 50.f, 63.f, 80.f, 100.f, 125.f, 160.f, 200.f, 250.f, 315.f, 400.f, 500.f, 630.f,
+        800.f, 1000.f, 1250.f, 1600.f, 2000.f, 2500.f, 3150.f, 4000.f, 5000.f, 6300.f, 8000.f, 10000.f, 12500.f,
+        16000.f, 20000.f
+    };
+    
+    const auto nyquist = (float) sampleRate * 0.5f;
+    Sections sections;
+    
+    // The defaults of the peak band, dynamic or not.
+    getBand(PeakBand, sampleRate, 750.f, 1.f, 0.f, false);
+    getDynamicBandPass(sampleRate, 750.f, 1.f, 0.f, false);
+    
+    for (auto frequency : thirdOctaves)
+    {
+        if (frequency >= nyquist)
+        {
+            break;
+        }
+        
+        for (int order = 2; order <= MaxCutOrder; order += 2)
+        {
+            getCut(sections, HighPass, Butterworth, sampleRate, frequency, order, false,
+                   [](Sections& s, double rate, double f, int o, CutType t) { designHighPass(s, rate, f, o, t); });
+            getCut(sections, LowPass, Butterworth, sampleRate, frequency, order, false,
+                   [](Sections& s, double rate, double f, int o, CutType t) { designLowPass(s, rate, f, o, t); });
+        }
+        
+        for (auto gain : { -12.f, -6.f, -3.f, 3.f, 6.f, 12.f })
+        {
+            getBand(PeakBand, sampleRate, frequency, 1.f, gain, false);
+        }
+    }
+}
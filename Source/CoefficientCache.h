@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    CoefficientCache.h
+    Remembers designed filters by their quantized parameters, so that
+    automation sweeps and preset recalls that revisit values look them up
+    instead of redesigning.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BiquadDesign.h"
+
+// A bounded open addressing table, shared by every instance in the process
+// through a juce::SharedResourcePointer. Lookups never lock: every slot is
+// guarded by a sequence number that the writer makes odd while it rewrites
+// the slot, and a reader that sees it change just treats the lookup as a miss.
+// Writers take a SpinLock, and skip caching rather than wait for it.
+//
+// Only values that lie on the grid of their parameter (1 Hz, 0.5 dB, Q in
+// steps of 0.05) get cached, anything else is designed directly.
+struct CoefficientCache
+{
+    static constexpr int MaxSections = MaxCutSections;
+    
+    using Sections = std::array<BiquadCoefficients, MaxSections>;
+    
+    CoefficientCache();
+    
+    // Designs the same as makeBandBiquad.
+    BiquadCoefficients getBand(BandType type, double sampleRate, float frequency, float quality, float gainDecibels);
+    
+    // Designs the same as makeDynamicBandPassBiquad. It is keyed on the band's
+    // own quality and gain, since the quality of the band pass itself is
+    // hardly ever on the grid.
+    BiquadCoefficients getDynamicBandPass(double sampleRate, float frequency, float quality, float gainDecibels);
+    
+    // Designs the same as designHighPass/LowPass, order / 2 sections are filled.
+    void getHighPass(Sections& sections, double sampleRate, float frequency, int order, CutType cutType);
+    void getLowPass(Sections& sections, double sampleRate, float frequency, int order, CutType cutType);
+    
+    // Not realtime safe. Fills the table with defaults and common values (every
+    // third octave, Butterworth cuts) for the given rate, which is the rate the
+    // filters run at, oversampling included. Its lookups don't count as hits
+    // or misses.
+    void prewarm(double sampleRate);
+    
+    int getNumHits() const { return numHits.get(); }
+    int getNumMisses() const { return numMisses.get(); }
+    
+    static size_t getMemoryUsage() { return NumSlots * sizeof(Slot); }
+    
+private:
+    static constexpr int NumSlots = 2048;
+    static constexpr int MaxProbes = 8;
+    
+    enum FilterType
+    {
+        Band,
+        HighPass,
+        LowPass,
+        DynamicBandPass
+    };
+    
+    struct Key
+    {
+        juce::uint64 sampleRateBits { 0 };
+        int type { -1 };
+        int variant { 0 }; // The band or cut type.
+        int order { 0 };
+        int frequency { 0 };
+        int gain { 0 };
+        int quality { 0 };
+        
+        bool operator==(const Key& other) const noexcept
+        {
+            return sampleRateBits == other.sampleRateBits && type == other.type && variant == other.variant
+                && order == other.order && frequency == other.frequency && gain == other.gain && quality == other.quality;
+        }
+        
+        juce::uint64 getHash() const noexcept;
+    };
+    
+    struct Slot
+    {
+        std::atomic<juce::uint32> sequence { 0 };
+        Key key;
+        Sections sections;
+    };
+    
+    // Returns false for values that aren't on the grid.
+    static bool makeKey(Key& key, FilterType type, int variant, double sampleRate, float frequency, int order,
+                        float gainDecibels, float quality);
+    
+    bool find(const Key& key, Sections& sections) const noexcept;
+    void insert(const Key& key, const Sections& sections) noexcept;
+    
+    // Looks key up, or designs and inserts it. Only counts as a hit or miss if
+    // countLookup is set.
+    template<typename DesignFunction>
+    void getSections(Sections& sections, const Key& key, bool cacheable, bool countLookup, DesignFunction&& design);
+    
+    BiquadCoefficients getBand(BandType type, double sampleRate, float frequency, float quality, float gainDecibels,
+                               bool countLookup);
+    BiquadCoefficients getDynamicBandPass(double sampleRate, float frequency, float quality, float gainDecibels,
+                                          bool countLookup);
+    
+    template<typename DesignFunction>
+    void getCut(Sections& sections, FilterType type, CutType cutType, double sampleRate, float frequency, int order,
+                bool countLookup, DesignFunction&& design);
+    
+    std::unique_ptr<Slot[]> slots;
+    juce::SpinLock writeLock;
+    
+    juce::Atomic<int> numHits { 0 }, numMisses { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE(CoefficientCache)
+};
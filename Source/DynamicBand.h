@@ -0,0 +1,222 @@
+/*
+  ==============================================================================
+
+    DynamicBand.h
+    A peak band whose gain follows an envelope, cheap enough to be modulated
+    every sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BiquadDesign.h"
+
+struct DynamicSettings
+{
+    bool enabled { false };
+    bool sidechain { false };
+    float thresholdDecibels { -24.f };
+    float ratio { 4.f };
+    float attackMs { 5.f };
+    float releaseMs { 100.f };
+};
+
+// A peak filter of gain g can be written as y = x + (g - 1) * bp(x), where bp
+// is a band pass with a peak gain of one. Only g depends on the gain, so a
+// band built this way can change its gain every sample for one multiply-add,
+// instead of redesigning and swapping biquad coefficients. The bandwidth of
+// the band pass is set from the static gain (see makeDynamicBandPassBiquad),
+// so that at its static gain the band is exactly the peak filter the band
+// would be if it weren't dynamic.
+//
+// g follows an envelope of the band passed signal, either of the band's own
+// input or of a sidechain, and pulls the band down by (1 - 1 / ratio) of
+// however far the envelope goes over the threshold. The envelope runs every
+// sample, the gain computer (which needs a log and an exp) once every
+// ControlInterval samples, and g is interpolated linearly in between.
+//
+// SampleType can either be a float or a juce::dsp::SIMDRegister, in which
+// case every lane gets its own envelope.
+template<typename SampleType>
+struct DynamicBand
+{
+    using NumericType = typename juce::dsp::SampleTypeHelpers::ElementType<SampleType>::Type;
+    
+    static constexpr size_t NumLanes = sizeof(SampleType) / sizeof(NumericType);
+    static constexpr int ControlInterval = 16;
+    
+    // The furthest the band gets pulled below its static gain.
+    static constexpr float MaxReductionDecibels = 30.f;
+    
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+    
+    void reset()
+    {
+        s1.fill(0);
+        s2.fill(0);
+        sidechainS1.fill(0);
+        sidechainS2.fill(0);
+        envelope.fill(0);
+        gain.fill(static_cast<NumericType>(juce::Decibels::decibelsToGain(staticGainDecibels)));
+        gainStep.fill(0);
+        samplesUntilControl = 0;
+    }
+    
+    // Expects a band pass with a peak gain of one, like makeDynamicBandPassBiquad.
+    void setBandPass(const BiquadCoefficients& coefficients)
+    {
+        b0 = static_cast<NumericType>(coefficients.b0);
+        b1 = static_cast<NumericType>(coefficients.b1);
+        b2 = static_cast<NumericType>(coefficients.b2);
+        a1 = static_cast<NumericType>(coefficients.a1);
+        a2 = static_cast<NumericType>(coefficients.a2);
+    }
+    
+    // The gain of the band while the envelope stays below the threshold.
+    void setStaticGain(float gainDecibels) { staticGainDecibels = gainDecibels; }
+    
+    void setParameters(const DynamicSettings& settings)
+    {
+        auto getCoefficient = [this](float milliseconds)
+        {
+            return static_cast<NumericType>(std::exp(-1.0 / (juce::jmax(0.01, (double) milliseconds) * 0.001 * sampleRate)));
+        };
+        
+        attack = getCoefficient(settings.attackMs);
+        release = getCoefficient(settings.releaseMs);
+        thresholdDecibels = settings.thresholdDecibels;
+        slope = 1.f - 1.f / juce::jmax(1.f, settings.ratio);
+    }
+    
+    // sidechain may be null, in which case the band listens to its own input.
+    void process(SampleType* samples, const SampleType* sidechain, size_t numSamples) noexcept
+    {
+        if (sidechain != nullptr)
+        {
+            processSamples<true>(reinterpret_cast<NumericType*>(samples),
+                                 reinterpret_cast<const NumericType*>(sidechain),
+                                 numSamples);
+        }
+        else
+        {
+            processSamples<false>(reinterpret_cast<NumericType*>(samples), nullptr, numSamples);
+        }
+    }
+    
+    // Only the band pass feeds the output, the envelope doesn't matter here.
+    bool hasDecayed(NumericType threshold) const noexcept
+    {
+        for (size_t lane = 0; lane < NumLanes; lane++)
+        {
+            if (std::abs(s1[lane]) > threshold || std::abs(s2[lane]) > threshold)
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+private:
+    using Lanes = std::array<NumericType, NumLanes>;
+    
+    NumericType b0 { 0 }, b1 { 0 }, b2 { 0 }, a1 { 0 }, a2 { 0 };
+    Lanes s1 {}, s2 {}, sidechainS1 {}, sidechainS2 {};
+    
+    NumericType attack { 0 }, release { 0 };
+    Lanes envelope {}, gain {}, gainStep {};
+    
+    float staticGainDecibels { 0.f }, thresholdDecibels { 0.f }, slope { 0.f };
+    int samplesUntilControl { 0 };
+    double sampleRate { 44100.0 };
+    
+    void updateGains() noexcept
+    {
+        for (size_t lane = 0; lane < NumLanes; lane++)
+        {
+            const auto over = juce::Decibels::gainToDecibels((float) envelope[lane], -100.f) - thresholdDecibels;
+            const auto reduction = over > 0.f ? juce::jmin(over * slope, MaxReductionDecibels) : 0.f;
+            const auto target = static_cast<NumericType>(juce::Decibels::decibelsToGain(staticGainDecibels - reduction));
+            
+            gainStep[lane] = (target - gain[lane]) / static_cast<NumericType>(ControlInterval);
+        }
+    }
+    
+    template<bool UseSidechain>
+    void processSamples(NumericType* samples, const NumericType* sidechain, size_t numSamples) noexcept
+    {
+        for (size_t n = 0; n < numSamples; n++)
+        {
+            if (samplesUntilControl == 0)
+            {
+                updateGains();
+                samplesUntilControl = ControlInterval;
+            }
+            
+            --samplesUntilControl;
+            
+            for (size_t lane = 0; lane < NumLanes; lane++)
+            {
+                const auto i = n * NumLanes + lane;
+                const auto x = samples[i];
+                
+                const auto bandPassed = x * b0 + s1[lane];
+                s1[lane] = x * b1 - bandPassed * a1 + s2[lane];
+                s2[lane] = x * b2 - bandPassed * a2;
+                
+                auto level = std::abs(bandPassed);
+                
+                if constexpr (UseSidechain)
+                {
+                    const auto key = sidechain[i];
+                    const auto keyBandPassed = key * b0 + sidechainS1[lane];
+                    sidechainS1[lane] = key * b1 - keyBandPassed * a1 + sidechainS2[lane];
+                    sidechainS2[lane] = key * b2 - keyBandPassed * a2;
+                    
+                    level = std::abs(keyBandPassed);
+                }
+                
+                const auto coefficient = level > envelope[lane] ? attack : release;
+                envelope[lane] = level + coefficient * (envelope[lane] - level);
+                
+                gain[lane] += gainStep[lane];
+                samples[i] = x + (gain[lane] - 1) * bandPassed;
+            }
+        }
+        
+        for (size_t lane = 0; lane < NumLanes; lane++)
+        {
+            juce::dsp::util::snapToZero(s1[lane]);
+            juce::dsp::util::snapToZero(s2[lane]);
+            juce::dsp::util::snapToZero(sidechainS1[lane]);
+            juce::dsp::util::snapToZero(sidechainS2[lane]);
+            juce::dsp::util::snapToZero(envelope[lane]);
+        }
+    }
+};
+
+// The RBJ peak of gain G = A^2 is 1 + (G - 1) * bp, with bp a unity peak band
+// pass of quality Q * A, so its bandwidth narrows for boosts and widens for
+// cuts. Designing the band pass for the static gain makes the dynamic band
+// match makePeakBiquad exactly while the detector is idle.
+inline double getDynamicBandPassQuality(double quality, double gainFactor)
+{
+    return quality * std::sqrt(juce::jmax(0.0, gainFactor));
+}
+
+inline BiquadCoefficients makeDynamicBandPassBiquad(double sampleRate, double frequency, double quality, double gainFactor)
+{
+    return makeBandPassBiquad(sampleRate, frequency, getDynamicBandPassQuality(quality, gainFactor));
+}
+
+// Magnitude of a dynamic band at its static gain, i.e. |1 + (g - 1) bp|.
+inline double getDynamicBandMagnitudeForFrequency(const BiquadCoefficients& bandPass, double gainFactor, double frequency,
+                                                  double sampleRate)
+{
+    return std::abs(1.0 + (gainFactor - 1.0) * getBiquadResponseForFrequency(bandPass, frequency, sampleRate));
+}
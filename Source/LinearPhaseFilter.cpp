@@ -0,0 +1,296 @@
+/*
+  ==============================================================================
+
+    LinearPhaseFilter.cpp
+
+  ==============================================================================
+*/
+
+#include "LinearPhaseFilter.h"
+
+void LinearPhaseFilter::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    numPreparedChannels = (int) spec.numChannels;
+    
+    inputs.setSize(numPreparedChannels, FFTSize);
+    outputs.setSize(numPreparedChannels, PartitionSize);
+    delayLine.assign((size_t) numPreparedChannels * MaxNumPartitions * NumBins * 2, 0.f);
+    
+    fftBuffer.assign((size_t) FFTSize * 2, 0.f);
+    accumulator.assign((size_t) NumBins * 2, 0.f);
+    
+    conversionBuffer.setSize(numPreparedChannels, (int) spec.maximumBlockSize);
+    
+    reset();
+}
+
+size_t LinearPhaseFilter::getMemoryUsage() const
+{
+    // Three kernels of whatever length was loaded last.
+    const auto numPartitions = (size_t) (kernelLength.get() / PartitionSize);
+    const auto kernelBytes = numPartitions * NumBins * 2 * sizeof(float) * 3;
+    
+    auto getBufferBytes = [](const juce::AudioBuffer<float>& buffer)
+    {
+        return (size_t) buffer.getNumChannels() * (size_t) buffer.getNumSamples() * sizeof(float);
+    };
+    
+    return kernelBytes
+         + (delayLine.size() + fftBuffer.size() + accumulator.size()) * sizeof(float)
+         + getBufferBytes(inputs) + getBufferBytes(outputs) + getBufferBytes(conversionBuffer);
+}
+
+void LinearPhaseFilter::reset()
+{
+    inputs.clear();
+    outputs.clear();
+    std::fill(delayLine.begin(), delayLine.end(), 0.f);
+    
+    delayLinePosition = 0;
+    blockPosition = 0;
+    samplesOfSilence = 0;
+}
+
+void LinearPhaseFilter::loadKernel(const std::function<double(double frequency)>& getMagnitudeForFrequency,
+                                   double sampleRate,
+                                   int numTaps)
+{
+    jassert(juce::isPowerOfTwo(numTaps) && numTaps >= PartitionSize && numTaps <= MaxNumTaps);
+    
+    juce::dsp::FFT designFFT(juce::roundToInt(std::log2(numTaps)));
+    
+    // Zero phase spectrum, the inverse transform gives an impulse that is
+    // symmetric around sample 0.
+    std::vector<float> data((size_t) numTaps * 2, 0.f);
+    
+    for (int bin = 0; bin <= numTaps / 2; bin++)
+    {
+        data[(size_t) bin * 2] = static_cast<float>(getMagnitudeForFrequency(bin * sampleRate / numTaps));
+    }
+    
+    designFFT.performRealOnlyInverseTransform(data.data());
+    
+    // Rotate the centre to numTaps / 2 and window it. The periodic Blackman
+    // window peaks exactly at numTaps / 2, so the kernel stays symmetric.
+    std::vector<float> kernelSamples((size_t) numTaps);
+    
+    for (int n = 0; n < numTaps; n++)
+    {
+        auto phase = juce::MathConstants<double>::twoPi * n / numTaps;
+        auto window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+        
+        kernelSamples[(size_t) n] = static_cast<float>(data[(size_t) ((n + numTaps / 2) % numTaps)] * window);
+    }
+    
+    // Not the audio thread's FFT, which would make the two threads contend
+    // for it.
+    juce::dsp::FFT partitionFFT(FFTOrder);
+    std::vector<float> partition((size_t) FFTSize * 2);
+    
+    auto& kernel = kernels.getWriteBuffer();
+    kernel.numPartitions = numTaps / PartitionSize;
+    kernel.partitions.resize((size_t) kernel.numPartitions * NumBins * 2);
+    
+    for (int p = 0; p < kernel.numPartitions; p++)
+    {
+        std::fill(partition.begin(), partition.end(), 0.f);
+        std::copy_n(kernelSamples.begin() + p * PartitionSize, PartitionSize, partition.begin());
+        
+        partitionFFT.performRealOnlyForwardTransform(partition.data(), true);
+        
+        std::copy_n(partition.begin(), NumBins * 2, kernel.partitions.begin() + (size_t) p * NumBins * 2);
+    }
+    
+    kernelLength.set(numTaps);
+    kernels.publish();
+}
+
+bool LinearPhaseFilter::shouldSkip(size_t numSamples, bool inputIsSilent)
+{
+    if (!inputIsSilent)
+    {
+        samplesOfSilence = 0;
+        return false;
+    }
+    
+    // Everything still in the convolution has come out once a whole kernel
+    // plus the partition delay worth of silence went in.
+    if (samplesOfSilence >= activeKernelLength + PartitionSize)
+    {
+        return true;
+    }
+    
+    samplesOfSilence += (int) numSamples;
+    return false;
+}
+
+bool LinearPhaseFilter::process(const juce::dsp::AudioBlock<float>& block, bool inputIsSilent)
+{
+    if (shouldSkip(block.getNumSamples(), inputIsSilent))
+    {
+        return false;
+    }
+    
+    processConvolutions(block);
+    return true;
+}
+
+void LinearPhaseFilter::processConvolutions(const juce::dsp::AudioBlock<float>& block)
+{
+    const auto numChannels = juce::jmin((int) block.getNumChannels(), numPreparedChannels);
+    const auto numSamples = (int) block.getNumSamples();
+    
+    // Every sample goes in at the position the output comes from, so the
+    // convolution delays by exactly one partition.
+    for (int start = 0; start < numSamples;)
+    {
+        const auto numToCopy = juce::jmin(numSamples - start, PartitionSize - blockPosition);
+        
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            auto* samples = block.getChannelPointer((size_t) channel) + start;
+            
+            juce::FloatVectorOperations::copy(inputs.getWritePointer(channel, PartitionSize + blockPosition), samples, numToCopy);
+            juce::FloatVectorOperations::copy(samples, outputs.getReadPointer(channel, blockPosition), numToCopy);
+        }
+        
+        start += numToCopy;
+        blockPosition += numToCopy;
+        
+        if (blockPosition == PartitionSize)
+        {
+            processPartition();
+            blockPosition = 0;
+        }
+    }
+}
+
+float* LinearPhaseFilter::getDelayLineSpectrum(int channel, int age)
+{
+    const auto index = (delayLinePosition - age + MaxNumPartitions) % MaxNumPartitions;
+    
+    return delayLine.data() + ((size_t) channel * MaxNumPartitions + (size_t) index) * NumBins * 2;
+}
+
+void LinearPhaseFilter::processPartition()
+{
+    delayLinePosition = (delayLinePosition + 1) % MaxNumPartitions;
+    
+    // The newest two blocks of input, zero padded, make the newest spectrum.
+    for (int channel = 0; channel < numPreparedChannels; channel++)
+    {
+        auto* input = inputs.getWritePointer(channel);
+        
+        juce::FloatVectorOperations::copy(fftBuffer.data(), input, FFTSize);
+        juce::FloatVectorOperations::clear(fftBuffer.data() + FFTSize, FFTSize);
+        
+        fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+        
+        juce::FloatVectorOperations::copy(getDelayLineSpectrum(channel, 0), fftBuffer.data(), NumBins * 2);
+        juce::FloatVectorOperations::copy(input, input + PartitionSize, PartitionSize);
+    }
+    
+    // A new kernel only gets pulled after the old one is done with, since the
+    // design thread may reuse its buffer right away.
+    const auto crossfade = kernels.hasNewData();
+    
+    for (int channel = 0; channel < numPreparedChannels; channel++)
+    {
+        convolve(channel, kernels.getReadBuffer());
+        juce::FloatVectorOperations::copy(outputs.getWritePointer(channel), fftBuffer.data() + PartitionSize, PartitionSize);
+    }
+    
+    if (!crossfade)
+    {
+        return;
+    }
+    
+    kernels.pull();
+    activeKernelLength = kernels.getReadBuffer().numPartitions * PartitionSize;
+    
+    for (int channel = 0; channel < numPreparedChannels; channel++)
+    {
+        convolve(channel, kernels.getReadBuffer());
+        
+        auto* output = outputs.getWritePointer(channel);
+        const auto* newOutput = fftBuffer.data() + PartitionSize;
+        
+        for (int i = 0; i < PartitionSize; i++)
+        {
+            const auto ramp = (i + 0.5f) / PartitionSize;
+            output[i] += ramp * (newOutput[i] - output[i]);
+        }
+    }
+}
+
+void LinearPhaseFilter::convolve(int channel, const Kernel& kernel)
+{
+    jassert(kernel.numPartitions <= MaxNumPartitions);
+    
+    std::fill(accumulator.begin(), accumulator.end(), 0.f);
+    
+    auto* sum = accumulator.data();
+    
+    for (int p = 0; p < kernel.numPartitions; p++)
+    {
+        const auto* x = getDelayLineSpectrum(channel, p);
+        const auto* h = kernel.partitions.data() + (size_t) p * NumBins * 2;
+        
+        for (int bin = 0; bin < NumBins * 2; bin += 2)
+        {
+            sum[bin]     += x[bin] * h[bin]     - x[bin + 1] * h[bin + 1];
+            sum[bin + 1] += x[bin] * h[bin + 1] + x[bin + 1] * h[bin];
+        }
+    }
+    
+    // The inverse transform wants the whole spectrum, the negative
+    // frequencies are the conjugates of the positive ones.
+    juce::FloatVectorOperations::copy(fftBuffer.data(), sum, NumBins * 2);
+    
+    for (int bin = NumBins; bin < FFTSize; bin++)
+    {
+        fftBuffer[(size_t) bin * 2] = sum[(FFTSize - bin) * 2];
+        fftBuffer[(size_t) bin * 2 + 1] = -sum[(FFTSize - bin) * 2 + 1];
+    }
+    
+    fft.performRealOnlyInverseTransform(fftBuffer.data());
+}
+
+bool LinearPhaseFilter::process(const juce::dsp::AudioBlock<double>& block, bool inputIsSilent)
+{
+    if (shouldSkip(block.getNumSamples(), inputIsSilent))
+    {
+        return false;
+    }
+    
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t) conversionBuffer.getNumChannels());
+    const auto numSamples = block.getNumSamples();
+    
+    jassert(numSamples <= (size_t) conversionBuffer.getNumSamples());
+    
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+        auto* source = block.getChannelPointer(channel);
+        auto* destination = conversionBuffer.getWritePointer((int) channel);
+        
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            destination[i] = static_cast<float>(source[i]);
+        }
+    }
+    
+    processConvolutions(juce::dsp::AudioBlock<float>(conversionBuffer).getSubBlock(0, numSamples));
+    
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+        auto* source = conversionBuffer.getReadPointer((int) channel);
+        auto* destination = block.getChannelPointer(channel);
+        
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            destination[i] = source[i];
+        }
+    }
+    
+    return true;
+}
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    LinearPhaseFilter.h
+    Runs the EQ as one symmetric FIR built from the magnitude response of the
+    chain, through uniformly partitioned FFT convolution.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "TripleBuffer.h"
+
+// Uniformly partitioned overlap-save convolution. The kernel is cut into
+// partitions of PartitionSize samples, each transformed once when the kernel
+// is loaded. Every PartitionSize samples of input get transformed once too and
+// go into a frequency domain delay line, and one output block is the inverse
+// transform of the sum of every partition times the matching delayed input.
+//
+// The kernel spectra are handed to the audio thread through a TripleBuffer,
+// so a kernel is in use from the first block after loadKernel returns. A new
+// kernel is crossfaded in over one partition.
+struct LinearPhaseFilter
+{
+    // Partition size of the convolution, which adds to the latency.
+    static constexpr int PartitionSize = 1024;
+    static constexpr int MaxNumTaps = 32768;
+    
+    // Not realtime safe.
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    // Not realtime safe, meant for the design thread. Samples the magnitude
+    // response at every bin of a numTaps long FFT and turns it into a linear
+    // phase kernel, which the audio thread picks up with its next block.
+    void loadKernel(const std::function<double(double frequency)>& getMagnitudeForFrequency,
+                    double sampleRate,
+                    int numTaps);
+    
+    // Returns false if the block was skipped, which happens once the input
+    // has been silent for longer than the kernel.
+    bool process(const juce::dsp::AudioBlock<float>& block, bool inputIsSilent);
+    bool process(const juce::dsp::AudioBlock<double>& block, bool inputIsSilent);
+    
+    // The kernel is centred on numTaps / 2.
+    static int getLatencyInSamples(int numTaps) { return numTaps / 2 + PartitionSize; }
+    
+    size_t getMemoryUsage() const;
+    
+private:
+    static constexpr int FFTOrder = 11;
+    static constexpr int FFTSize = 1 << FFTOrder;
+    static constexpr int NumBins = FFTSize / 2 + 1;
+    static constexpr int MaxNumPartitions = MaxNumTaps / PartitionSize;
+    
+    static_assert(FFTSize == PartitionSize * 2, "Each partition is transformed zero padded to twice its size");
+    
+    // Spectra of the partitions, NumBins interleaved complex values each.
+    struct Kernel
+    {
+        std::vector<float> partitions;
+        int numPartitions { 0 };
+    };
+    
+    const juce::dsp::FFT fft { FFTOrder };
+    
+    TripleBuffer<Kernel> kernels;
+    juce::Atomic<int> kernelLength { 0 };
+    
+    // Audio thread only, sized in prepare. The last two blocks of input and
+    // the output block that is being played back, per channel.
+    juce::AudioBuffer<float> inputs, outputs;
+    std::vector<float> delayLine;
+    int delayLinePosition { 0 };
+    int blockPosition { 0 };
+    int numPreparedChannels { 0 };
+    int samplesOfSilence { 0 };
+    
+    // Length of the kernel the audio thread has actually swapped in, which
+    // the silence detection goes by. kernelLength may already be ahead of it.
+    int activeKernelLength { 0 };
+    
+    // Scratch space for one transform and one accumulated spectrum.
+    std::vector<float> fftBuffer, accumulator;
+    
+    float* getDelayLineSpectrum(int channel, int age);
+    
+    bool shouldSkip(size_t numSamples, bool inputIsSilent);
+    void processConvolutions(const juce::dsp::AudioBlock<float>& block);
+    void processPartition();
+    void convolve(int channel, const Kernel& kernel);
+    
+    // Double precision blocks are converted through this.
+    juce::AudioBuffer<float> conversionBuffer;
+};
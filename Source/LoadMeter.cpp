@@ -0,0 +1,168 @@
+/*
+  ==============================================================================
+
+    LoadMeter.cpp
+
+  ==============================================================================
+*/
+
+#include "LoadMeter.h"
+
+LoadMeter::LoadMeter()
+{
+    clear();
+}
+
+void LoadMeter::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    ticksPerSecond = (double) juce::Time::getHighResolutionTicksPerSecond();
+    
+    clear();
+    resetRequested.set(false);
+}
+
+void LoadMeter::blockStarted() noexcept
+{
+    startTicks = juce::Time::getHighResolutionTicks();
+}
+
+void LoadMeter::blockFinished(int numSamples, int events) noexcept
+{
+    const auto elapsedSeconds = (double) (juce::Time::getHighResolutionTicks() - startTicks) / ticksPerSecond;
+    
+    if (resetRequested.compareAndSetBool(false, true))
+    {
+        clear();
+    }
+    
+    if (numSamples <= 0)
+    {
+        return;
+    }
+    
+    const auto load = (float) (elapsedSeconds * sampleRate / numSamples);
+    const auto overrun = load > overrunThreshold.get();
+    
+    ++histogram[(size_t) getBinForLoad(load)];
+    ++numBlocks;
+    
+    lastLoad.set(load);
+    
+    if (load > maxLoad.get())
+    {
+        maxLoad.set(load);
+    }
+    
+    if (overrun)
+    {
+        ++numOverruns;
+    }
+    
+    if ((events & CoefficientUpdate) != 0)
+    {
+        ++numBlocksWithCoefficientUpdate;
+        
+        if (overrun)
+        {
+            ++numOverrunsWithCoefficientUpdate;
+        }
+    }
+    
+    if ((events & AnalyzerPush) != 0)
+    {
+        ++numBlocksWithAnalyzerPush;
+        
+        if (overrun)
+        {
+            ++numOverrunsWithAnalyzerPush;
+        }
+    }
+}
+
+LoadMeter::Statistics LoadMeter::getStatistics() const
+{
+    Statistics statistics;
+    
+    statistics.numBlocks = numBlocks.get();
+    statistics.numOverruns = numOverruns.get();
+    statistics.lastLoad = lastLoad.get();
+    statistics.maxLoad = maxLoad.get();
+    statistics.numBlocksWithCoefficientUpdate = numBlocksWithCoefficientUpdate.get();
+    statistics.numOverrunsWithCoefficientUpdate = numOverrunsWithCoefficientUpdate.get();
+    statistics.numBlocksWithAnalyzerPush = numBlocksWithAnalyzerPush.get();
+    statistics.numOverrunsWithAnalyzerPush = numOverrunsWithAnalyzerPush.get();
+    
+    // The audio thread may add to the histogram while it's read, so the total
+    // comes from the bins rather than from numBlocks.
+    std::array<int, NumBins> counts;
+    auto total = 0;
+    
+    for (int bin = 0; bin < NumBins; bin++)
+    {
+        counts[(size_t) bin] = histogram[(size_t) bin].get();
+        total += counts[(size_t) bin];
+    }
+    
+    if (total == 0)
+    {
+        return statistics;
+    }
+    
+    auto getPercentile = [&](double fraction)
+    {
+        const auto target = juce::jmax(1, (int) std::ceil(fraction * total));
+        auto count = 0;
+        
+        for (int bin = 0; bin < NumBins; bin++)
+        {
+            count += counts[(size_t) bin];
+            
+            if (count >= target)
+            {
+                // No bin reaches past the largest load that was measured.
+                return juce::jmin(getLoadForBin(bin), statistics.maxLoad);
+            }
+        }
+        
+        return statistics.maxLoad;
+    };
+    
+    statistics.medianLoad = getPercentile(0.5);
+    statistics.p99Load = getPercentile(0.99);
+    
+    return statistics;
+}
+
+int LoadMeter::getBinForLoad(float load) noexcept
+{
+    if (load <= LowestLoad)
+    {
+        return 0;
+    }
+    
+    return juce::jlimit(0, NumBins - 1, (int) (std::log10(load / LowestLoad) * BinsPerDecade));
+}
+
+float LoadMeter::getLoadForBin(int bin) noexcept
+{
+    // Upper edge of the bin.
+    return LowestLoad * std::pow(10.f, (float) (bin + 1) / (float) BinsPerDecade);
+}
+
+void LoadMeter::clear() noexcept
+{
+    for (auto& count : histogram)
+    {
+        count.set(0);
+    }
+    
+    numBlocks.set(0);
+    numOverruns.set(0);
+    lastLoad.set(0.f);
+    maxLoad.set(0.f);
+    numBlocksWithCoefficientUpdate.set(0);
+    numOverrunsWithCoefficientUpdate.set(0);
+    numBlocksWithAnalyzerPush.set(0);
+    numOverrunsWithAnalyzerPush.set(0);
+}
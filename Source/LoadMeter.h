@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    LoadMeter.h
+    Measures how much of each block's realtime budget (numSamples / sampleRate)
+    processBlock uses, so that a spiking instance can be found among many.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+struct LoadMeter
+{
+    // Things that happen during a block and may explain a slow one.
+    enum Event
+    {
+        NoEvents = 0,
+        CoefficientUpdate = 1 << 0, // New coefficients were picked up.
+        AnalyzerPush = 1 << 1       // A buffer was pushed to an analyzer FIFO.
+    };
+    
+    // Loads are fractions of the budget, so 1 means the whole block period.
+    struct Statistics
+    {
+        int numBlocks { 0 };
+        int numOverruns { 0 };
+        
+        float lastLoad { 0.f };
+        float medianLoad { 0.f };
+        float p99Load { 0.f };
+        float maxLoad { 0.f };
+        
+        int numBlocksWithCoefficientUpdate { 0 }, numOverrunsWithCoefficientUpdate { 0 };
+        int numBlocksWithAnalyzerPush { 0 }, numOverrunsWithAnalyzerPush { 0 };
+    };
+    
+    LoadMeter();
+    
+    // Not realtime safe, clears everything.
+    void prepare(double sampleRate);
+    
+    // Audio thread only.
+    void blockStarted() noexcept;
+    void blockFinished(int numSamples, int events) noexcept;
+    
+    // Blocks that take more than this fraction of their budget count as
+    // overruns. An instance that shares the CPU with many others should get a
+    // lot less than all of it.
+    void setOverrunThreshold(float fractionOfBudget) { overrunThreshold.set(juce::jmax(0.f, fractionOfBudget)); }
+    float getOverrunThreshold() const { return overrunThreshold.get(); }
+    
+    // Can be called from any thread. Percentiles are accurate to the width of
+    // a histogram bin, which is about 6%.
+    Statistics getStatistics() const;
+    
+    // Can be called from any thread, takes effect with the next block.
+    void reset() { resetRequested.set(true); }
+    
+private:
+    // Log spaced bins from 1e-4 to 10 times the budget.
+    static constexpr int BinsPerDecade = 40;
+    static constexpr int NumDecades = 5;
+    static constexpr int NumBins = BinsPerDecade * NumDecades;
+    static constexpr float LowestLoad = 1.0e-4f;
+    
+    static int getBinForLoad(float load) noexcept;
+    static float getLoadForBin(int bin) noexcept;
+    
+    void clear() noexcept;
+    
+    // Written by the audio thread only, read from anywhere.
+    std::array<juce::Atomic<int>, NumBins> histogram;
+    juce::Atomic<int> numBlocks { 0 }, numOverruns { 0 };
+    juce::Atomic<float> lastLoad { 0.f }, maxLoad { 0.f };
+    juce::Atomic<int> numBlocksWithCoefficientUpdate { 0 }, numOverrunsWithCoefficientUpdate { 0 };
+    juce::Atomic<int> numBlocksWithAnalyzerPush { 0 }, numOverrunsWithAnalyzerPush { 0 };
+    
+    juce::Atomic<float> overrunThreshold { 1.f };
+    juce::Atomic<bool> resetRequested { false };
+    
+    double ticksPerSecond { 1.0 };
+    double sampleRate { 44100.0 };
+    juce::int64 startTicks { 0 };
+};
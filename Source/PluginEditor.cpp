@@ -64,7 +64,7 @@ void LookAndFeel::drawRotarySlider(juce::Graphics &g,
     
     // Draw slider value.
     
-    g.setFont(rswl->getTextHeight());
+    g.setFont(fonts->getFont((float) rswl->getTextHeight()));
     
     auto text = rswl->getDisplayString();
     auto textWidth = g.getCurrentFont().getStringWidth(text);
@@ -165,7 +165,7 @@ void RotarySliderWithLabels::paint(juce::Graphics &g)
     auto radius = sliderBounds.getWidth() / 2.0f;
     
     g.setColour(juce::Colours::greenyellow);
-    g.setFont(getTextHeight());
+    g.setFont(fonts->getFont((float) getTextHeight()));
     
     for (auto label : labels)
     {
@@ -244,50 +244,145 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 
 //==============================================================================
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
+void PathProducer::setBounds(juce::Rectangle<float> fftBounds, double newSampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    const juce::SpinLock::ScopedLockType sl(boundsLock);
+    bounds = fftBounds;
+    boundsSampleRate = newSampleRate;
+}
+
+void PathProducer::changeOrder(FFTOrder newOrder)
+{
+    fftDataGenerator.changeOrder(newOrder);
+    
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    
+    analysisWindow.setSize(fftSize);
+    fftData.assign((size_t) fftSize * 2, 0.f);
+    
+    // The hop depends on the FFT size.
+    scheduledSampleRate = 0.0;
+}
+
+void PathProducer::process()
+{
+    // The shared FFT plans are only safe to use from this one thread.
+    jassert(dynamic_cast<AnalyzerThread*>(juce::Thread::getCurrentThread()) != nullptr);
+    
+    juce::Rectangle<float> fftBounds;
+    double sampleRate = 0.0;
+    
+    {
+        const juce::SpinLock::ScopedLockType sl(boundsLock);
+        fftBounds = bounds;
+        sampleRate = boundsSampleRate;
+    }
+    
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    
+    if (sampleRate != scheduledSampleRate)
+    {
+        scheduler.prepare(fftSize, sampleRate, AnalyzerFifos::ConsumerRateHz);
+        scheduledSampleRate = sampleRate;
+    }
     
-    // Produce FFT data.
+    scheduler.setOverlap(overlap.get());
+    
+    // Keep the window up to date with every sample that came in. Each block
+    // is written into the ring once, nothing already in there moves. The FIFO
+    // pulls into a buffer it sized when it was prepared, so nothing here has
+    // to follow block size or rate changes.
     
     while (sampleFifo->getNumCompleteBuffersAvailable() > 0)
     {
-        if (sampleFifo->getAudioBuffer(tempIncomingBuffer))
-        {
-            auto size = tempIncomingBuffer.getNumSamples();
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0, 0),
-                                              size);
-            
-            fftDataGenerator.produceFFTDataForRendering(monoBuffer, -48.0f);
-        }
+        sampleFifo->readAudioBuffer([this](const juce::AudioBuffer<float>& buffer)
+                                    {
+                                        auto size = buffer.getNumSamples();
+                                        
+                                        analysisWindow.push(buffer.getReadPointer(0), size);
+                                        scheduler.addSamples(size);
+                                    });
     }
     
+    // Only the newest frame would be shown, so at most that one gets
+    // computed, and only once a hop's worth of audio has come in.
+    if (fftBounds.isEmpty() || sampleRate <= 0.0 || !scheduler.isFrameDue())
+    {
+        return;
+    }
+    
+    fftDataGenerator.produceFFTDataForRendering(analysisWindow, -48.0f);
+    scheduler.frameComputed();
+    
     // Produce paths to render from FFT data.
     
-    const auto fftSize = fftDataGenerator.getFFTSize();
     const auto binWidth = sampleRate / (double) fftSize;
     
     while (fftDataGenerator.getNumAvailableFFTDataBlocks() > 0)
     {
-        std::vector<float> fftData;
-        
         if (fftDataGenerator.getFFTData(fftData))
         {
             pathProducer.generatePath(fftData, fftBounds.toFloat(), fftSize, binWidth, -48.0f);
         }
     }
     
-    // Store most recent path.
+    // Publish most recent path.
+    
+    auto hasNewPath = false;
     
     while (pathProducer.getNumPathsAvailable() > 0)
     {
-        pathProducer.getPath(fftPath);
+        hasNewPath = pathProducer.getPath(fftPath) || hasNewPath;
+    }
+    
+    if (hasNewPath)
+    {
+        paths.getWriteBuffer() = fftPath;
+        paths.publish();
+    }
+}
+
+//==============================================================================
+
+AnalyzerThread::AnalyzerThread() : juce::Thread("SimpleEQ Analyzer")
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+AnalyzerThread::~AnalyzerThread()
+{
+    stopThread(1000);
+}
+
+void AnalyzerThread::addProducer(PathProducer* producer)
+{
+    const juce::ScopedLock sl(lock);
+    producers.addIfNotAlreadyThere(producer);
+}
+
+void AnalyzerThread::removeProducer(PathProducer* producer)
+{
+    const juce::ScopedLock sl(lock);
+    producers.removeFirstMatchingValue(producer);
+}
+
+void AnalyzerThread::run()
+{
+    while (!threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(lock);
+            
+            for (auto* producer : producers)
+            {
+                if (producer->isEnabled())
+                {
+                    producer->process();
+                }
+            }
+        }
+        
+        wait(FrameIntervalMs);
     }
 }
 
@@ -295,8 +390,9 @@ void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 
 ResponseCurveComponent::ResponseCurveComponent(SimpleEQAudioProcessor& p) :
 audioProcessor(p),
-leftChannelPathProducer(audioProcessor.leftChannelFifo),
-rightChannelPathProducer(audioProcessor.rightChannelFifo)
+analyzerFifos(p.attachAnalyzer()),
+leftChannelPathProducer(analyzerFifos.left),
+rightChannelPathProducer(analyzerFifos.right)
 {
     const auto& params = audioProcessor.getParameters();
     
@@ -307,6 +403,9 @@ rightChannelPathProducer(audioProcessor.rightChannelFifo)
         
     updateChain();
     
+    analyzerThread->addProducer(&leftChannelPathProducer);
+    analyzerThread->addProducer(&rightChannelPathProducer);
+    
     startTimerHz(60);
 }
 
@@ -318,6 +417,11 @@ ResponseCurveComponent::~ResponseCurveComponent()
     {
         param->removeListener(this);
     }
+    
+    analyzerThread->removeProducer(&leftChannelPathProducer);
+    analyzerThread->removeProducer(&rightChannelPathProducer);
+    
+    audioProcessor.detachAnalyzer();
 }
 
 void ResponseCurveComponent::paint (juce::Graphics& g)
@@ -333,70 +437,13 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     
     // Response Curve
     
-    auto& lowCut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highCut = monoChain.get<ChainPositions::HighCut>();
-    
-    auto sampleRate = audioProcessor.getSampleRate();
-    
     std::vector<double> magnitudes;
     magnitudes.resize(w);
     
     for (int i = 0; i < w; i++)
     {
-        auto magnitude = 1.0;
         auto freq = juce::mapToLog10(double(i) / double(w), 20.0, 20000.0);
-        
-        if (!monoChain.isBypassed<ChainPositions::Peak>())
-        {
-            magnitude *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-             
-        if (!monoChain.isBypassed<ChainPositions::LowCut>())
-        {
-            if (!lowCut.isBypassed<0>())
-            {
-                magnitude *= lowCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!lowCut.isBypassed<1>())
-            {
-                magnitude *= lowCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!lowCut.isBypassed<2>())
-            {
-                magnitude *= lowCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!lowCut.isBypassed<3>())
-            {
-                magnitude *= lowCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-        }
-        
-        if (!monoChain.isBypassed<ChainPositions::HighCut>())
-        {
-            if (!highCut.isBypassed<0>())
-            {
-                magnitude *= highCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!highCut.isBypassed<1>())
-            {
-                magnitude *= highCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!highCut.isBypassed<2>())
-            {
-                magnitude *= highCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-            
-            if (!highCut.isBypassed<3>())
-            {
-                magnitude *= highCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            }
-        }
+        auto magnitude = getChainMagnitudeForFrequency(chainCoefficients, freq);
         
         magnitudes[i] = juce::Decibels::gainToDecibels(magnitude);
     }
@@ -449,13 +496,14 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
 
 void ResponseCurveComponent::timerCallback()
 {
+    // The analyzer thread does the work, it only needs to know where to draw.
     if (fftAnalysisEnabled)
     {
         auto fftBounds = getAnalysisArea().toFloat();
         auto sampleRate = audioProcessor.getSampleRate();
         
-        leftChannelPathProducer.process(fftBounds, sampleRate);
-        rightChannelPathProducer.process(fftBounds, sampleRate);
+        leftChannelPathProducer.setBounds(fftBounds, sampleRate);
+        rightChannelPathProducer.setBounds(fftBounds, sampleRate);
     }
     
     if (parametersChanged.compareAndSetBool(false, true))
@@ -469,26 +517,31 @@ void ResponseCurveComponent::timerCallback()
 void ResponseCurveComponent::updateChain()
 {
     auto chainSettings = getChainSettings(audioProcessor.apvts);
+    auto sampleRate = audioProcessor.getSampleRate();
     
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    // Nothing to design for until the processor has been prepared.
+    if (sampleRate <= 0.0)
+    {
+        return;
+    }
     
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCutCoefficients(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutCoefficients(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    // Designed at the rate the processor runs the filters at, so the curve
+    // shows what is heard near Nyquist, and the shared cache has what the
+    // processor designed.
+    chainCoefficients = makeChainCoefficients(chainSettings,
+                                              getOversampledRate(sampleRate, chainSettings.oversampling),
+                                              &coefficientCache.getObject());
 }
 
 void ResponseCurveComponent::resized()
 {
-    background = juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true);
-    
-    juce::Graphics g(background);
+    const auto scale = juce::Component::getApproximateScaleFactorForComponent(this);
     
+    background = gridImages->getImage(getWidth(), getHeight(), scale, [this](juce::Graphics& g) { drawGrid(g); });
+}
+
+void ResponseCurveComponent::drawGrid(juce::Graphics& g)
+{
     g.setColour(juce::Colours::dimgrey);
     
     auto renderArea = getAnalysisArea();
@@ -542,7 +595,7 @@ void ResponseCurveComponent::resized()
     
     const int fontHeight = 10;
     
-    g.setFont(fontHeight);
+    g.setFont(fonts->getFont((float) fontHeight));
     g.setColour(juce::Colours::white);
     
     for (int i = 0; i < freqs.size(); i++)
@@ -695,10 +748,10 @@ analyzerEnabledAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnab
         addAndMakeVisible(comp);
     }
     
-    peakBypassButton.setLookAndFeel(&lnf);
-    lowCutBypassButton.setLookAndFeel(&lnf);
-    highCutBypassButton.setLookAndFeel(&lnf);
-    analyzerEnabledButton.setLookAndFeel(&lnf);
+    peakBypassButton.setLookAndFeel(&lnf.getObject());
+    lowCutBypassButton.setLookAndFeel(&lnf.getObject());
+    highCutBypassButton.setLookAndFeel(&lnf.getObject());
+    analyzerEnabledButton.setLookAndFeel(&lnf.getObject());
     
     auto safePtr = juce::Component::SafePointer<SimpleEQAudioProcessorEditor>(this);
     
@@ -742,6 +795,13 @@ analyzerEnabledAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnab
         }
     };
     
+    loadMeterLabel.setFont(fonts->getFont(12.f));
+    loadMeterLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    loadMeterLabel.setJustificationType(juce::Justification::centredLeft);
+    addAndMakeVisible(loadMeterLabel);
+    
+    startTimerHz(4);
+    
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
         
@@ -771,6 +831,7 @@ void SimpleEQAudioProcessorEditor::resized()
     auto bounds = getLocalBounds();
     
     auto analyzerEnabledArea = bounds.removeFromTop(25);
+    auto loadMeterArea = analyzerEnabledArea.withTrimmedLeft(110).withTrimmedRight(5);
     analyzerEnabledArea.setWidth(100);
     analyzerEnabledArea.setX(5);
     analyzerEnabledArea.removeFromTop(2);
@@ -810,10 +871,33 @@ void SimpleEQAudioProcessorEditor::resized()
     peakQualitySlider.setBounds(peakQualityArea);
     
     analyzerEnabledButton.setBounds(analyzerEnabledArea);
+    loadMeterLabel.setBounds(loadMeterArea);
     
     responseCurveComponent.setBounds(responseArea);
 }
 
+void SimpleEQAudioProcessorEditor::timerCallback()
+{
+    auto statistics = audioProcessor.getLoadStatistics();
+    
+    auto percent = [](float load) { return juce::String(load * 100.f, 1) + "%"; };
+    
+    juce::String text;
+    text << "DSP " << percent(statistics.medianLoad)
+         << "  p99 " << percent(statistics.p99Load)
+         << "  max " << percent(statistics.maxLoad)
+         << "  overruns " << statistics.numOverruns;
+    
+    // Whatever the overruns coincided with.
+    if (statistics.numOverruns > 0)
+    {
+        text << " (" << statistics.numOverrunsWithCoefficientUpdate << " on redesign, "
+             << statistics.numOverrunsWithAnalyzerPush << " on analyzer push)";
+    }
+    
+    loadMeterLabel.setText(text, juce::dontSendNotification);
+}
+
 std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
 {
     return
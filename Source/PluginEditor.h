@@ -10,6 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SharedResources.h"
 
 enum FFTOrder
 {
@@ -18,6 +19,55 @@ enum FFTOrder
     order8192 = 13
 };
 
+// The newest samples of a channel, kept in a ring so that adding a block only
+// ever copies the block itself. The window comes out in order, oldest sample
+// first, in at most two copies, and only when a frame actually needs it.
+struct AnalysisWindow
+{
+    // Not realtime safe. Starts out silent.
+    void setSize(int newSize)
+    {
+        buffer.assign((size_t) newSize, 0.f);
+        writePosition = 0;
+    }
+    
+    int getSize() const { return (int) buffer.size(); }
+    
+    void push(const float* samples, int numSamples)
+    {
+        const auto size = getSize();
+        
+        // Only the last size samples of a longer block can end up in the window.
+        if (numSamples >= size)
+        {
+            juce::FloatVectorOperations::copy(buffer.data(), samples + numSamples - size, size);
+            writePosition = 0;
+            return;
+        }
+        
+        const auto numToEnd = juce::jmin(numSamples, size - writePosition);
+        
+        juce::FloatVectorOperations::copy(buffer.data() + writePosition, samples, numToEnd);
+        juce::FloatVectorOperations::copy(buffer.data(), samples + numToEnd, numSamples - numToEnd);
+        
+        writePosition = (writePosition + numSamples) % size;
+    }
+    
+    // Fills getSize() samples of destination.
+    void copyTo(float* destination) const
+    {
+        const auto size = getSize();
+        const auto numToEnd = size - writePosition;
+        
+        juce::FloatVectorOperations::copy(destination, buffer.data() + writePosition, numToEnd);
+        juce::FloatVectorOperations::copy(destination + numToEnd, buffer.data(), writePosition);
+    }
+    
+private:
+    std::vector<float> buffer;
+    int writePosition { 0 };
+};
+
 template<typename BlockType>
 struct FFTDataGenerator
 {
@@ -25,12 +75,66 @@ struct FFTDataGenerator
     {
         const auto fftSize = getFFTSize();
         
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        juce::FloatVectorOperations::copy(fftData.data(), audioData.getReadPointer(0), fftSize);
+        transform(negativeInfinity);
+    }
+    
+    // Gathers the window straight out of the ring.
+    void produceFFTDataForRendering(const AnalysisWindow& analysisWindow, const float negativeInfinity)
+    {
+        jassert(analysisWindow.getSize() == getFFTSize());
+        
+        analysisWindow.copyTo(fftData.data());
+        transform(negativeInfinity);
+    }
+    
+    void changeOrder(FFTOrder newOrder)
+    {
+        order = newOrder;
+        
+        auto fftSize = getFFTSize();
+        
+        // Shared by every analyzer in the process.
+        forwardFFT = &resources->getFFT(order);
+        window = &resources->getWindow(order);
+        
+        fftData.clear();
+        fftData.resize(fftSize * 2, 0);
+        
+        fftDataFifo.prepare(fftData.size());
+    }
+    
+    // Not realtime safe. Holds capacity - 1 blocks.
+    void setCapacity(int capacity)
+    {
+        fftDataFifo.setCapacity(capacity);
+        fftDataFifo.prepare(fftData.size());
+    }
+    
+    int getFFTSize() const { return 1 << order; }
+    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    
+    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    
+private:
+    FFTOrder order;
+    BlockType fftData;
+    juce::SharedResourcePointer<AnalyzerResources> resources;
+    const juce::dsp::FFT* forwardFFT = nullptr;
+    const juce::dsp::WindowingFunction<float>* window = nullptr;
+    
+    Fifo<BlockType> fftDataFifo;
+    
+    // Expects the first fftSize samples of fftData to hold the input.
+    void transform(const float negativeInfinity)
+    {
+        const auto fftSize = getFFTSize();
+        
+        // The frequency only transform works in place on twice the samples.
+        juce::FloatVectorOperations::clear(fftData.data() + fftSize, fftSize);
         
         // Apply windowing function.
-        window->multiplyWithWindowingTable(fftData.data(), fftSize);
+        window->multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
         
         // Apply FFT transform.
         forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());
@@ -51,34 +155,53 @@ struct FFTDataGenerator
         
         fftDataFifo.push(fftData);
     }
+};
+
+// Decides when the analyzer computes a frame. Frames are a fixed hop apart,
+// which follows from how much consecutive FFT windows overlap, but never
+// closer than the display can show them, and only the newest frame due gets
+// computed. How the host slices up the audio doesn't matter.
+struct AnalyzerScheduler
+{
+    void prepare(int newFFTSize, double newSampleRate, double maxFramesPerSecond)
+    {
+        fftSize = newFFTSize;
+        sampleRate = newSampleRate;
+        framesPerSecond = maxFramesPerSecond;
+        samplesSinceFrame = 0;
+        updateHopSize();
+    }
     
-    void changeOrder(FFTOrder newOrder)
+    // The fraction of each window the next one overlaps, from 0 to 95 %.
+    void setOverlap(float overlapPercent)
     {
-        order = newOrder;
-        
-        auto fftSize = getFFTSize();
-        
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-        
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
-        
-        fftDataFifo.prepare(fftData.size());
+        overlap = juce::jlimit(0.f, 95.f, overlapPercent) / 100.f;
+        updateHopSize();
     }
     
-    int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    void addSamples(int numSamples) { samplesSinceFrame += numSamples; }
+    bool isFrameDue() const { return samplesSinceFrame >= hopSize; }
     
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    // Anything that was due is covered by the frame just computed.
+    void frameComputed() { samplesSinceFrame = 0; }
     
-private:
-    FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    int getHopSize() const { return hopSize; }
     
-    Fifo<BlockType> fftDataFifo;
+private:
+    int fftSize { 2048 };
+    double sampleRate { 44100.0 };
+    double framesPerSecond { 60.0 };
+    float overlap { 0.75f };
+    int hopSize { 512 };
+    juce::int64 samplesSinceFrame { 0 };
+    
+    void updateHopSize()
+    {
+        const auto overlapHop = juce::jmax(1, juce::roundToInt((float) fftSize * (1.f - overlap)));
+        const auto displayHop = (int) std::ceil(sampleRate / juce::jmax(1.0, framesPerSecond));
+        
+        hopSize = juce::jmax(overlapHop, displayHop);
+    }
 };
 
 template<typename PathType>
@@ -135,6 +258,12 @@ struct AnalyzerPathGenerator
         return pathFifo.getNumAvailableForReading();
     }
     
+    // Not realtime safe. Holds capacity - 1 paths.
+    void setCapacity(int capacity)
+    {
+        pathFifo.setCapacity(capacity);
+    }
+    
     bool getPath(PathType& path)
     {
         return pathFifo.pull(path);
@@ -188,6 +317,8 @@ struct LookAndFeel : juce::LookAndFeel_V4
 private:
     void drawPowerButton(juce::Graphics&, PowerButton&);
     void drawAnalyzerButton(juce::Graphics&, AnalyzerButton&);
+    
+    juce::SharedResourcePointer<EditorFonts> fonts;
 };
 
 struct RotarySliderWithLabels : juce::Slider
@@ -197,7 +328,7 @@ struct RotarySliderWithLabels : juce::Slider
     param(&p),
     suffix(s)
     {
-        setLookAndFeel(&lnf);
+        setLookAndFeel(&lnf.getObject());
     }
     
     ~RotarySliderWithLabels()
@@ -219,35 +350,92 @@ struct RotarySliderWithLabels : juce::Slider
     juce::String getDisplayString() const;
     
 private:
-    LookAndFeel lnf;
+    // It has no state, one for the whole process does.
+    juce::SharedResourcePointer<LookAndFeel> lnf;
+    juce::SharedResourcePointer<EditorFonts> fonts;
     
     juce::RangedAudioParameter* param;
     juce::String suffix;
 };
 
+// Turns the audio of one channel into spectrum paths. The FFTs and the paths
+// are made on the AnalyzerThread, the editor only tells it where to draw and
+// picks up the newest finished path.
 struct PathProducer
 {
     PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& scsf) :
     sampleFifo(&scsf)
     {
-        fftDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, fftDataGenerator.getFFTSize());
+        // Every pass computes one frame at most and drains it right away.
+        fftDataGenerator.setCapacity(2);
+        pathProducer.setCapacity(2);
+        
+        changeOrder(FFTOrder::order2048);
     }
     
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
+    // Analyzer thread only.
+    void process();
     
-    juce::Path getPath() { return fftPath; }
+    // Message thread only.
+    void setBounds(juce::Rectangle<float> fftBounds, double sampleRate);
+    void setEnabled(bool shouldBeEnabled) { enabled.set(shouldBeEnabled); }
+    void setOverlap(float overlapPercent) { overlap.set(overlapPercent); }
+    bool isEnabled() const { return enabled.get(); }
+    
+    // Message thread only. Never blocks, just swaps in the newest path if the
+    // analyzer thread has finished one since.
+    const juce::Path& getPath()
+    {
+        paths.pull();
+        return paths.getReadBuffer();
+    }
     
 private:
     SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* sampleFifo;
     
-    juce::AudioBuffer<float> monoBuffer;
+    // Everything the analyzer thread works on is sized here, so process()
+    // never allocates. Not realtime safe.
+    void changeOrder(FFTOrder newOrder);
+    
+    AnalysisWindow analysisWindow;
+    std::vector<float> fftData;
     
     FFTDataGenerator<std::vector<float>> fftDataGenerator;
     
     AnalyzerPathGenerator<juce::Path> pathProducer;
     
+    AnalyzerScheduler scheduler;
+    double scheduledSampleRate { 0.0 };
+    juce::Atomic<float> overlap { 75.f };
+    
     juce::Path fftPath;
+    TripleBuffer<juce::Path> paths;
+    
+    juce::SpinLock boundsLock;
+    juce::Rectangle<float> bounds;
+    double boundsSampleRate { 0.0 };
+    
+    juce::Atomic<bool> enabled { true };
+};
+
+// One low priority thread per process that runs the analyzers of every open
+// editor, so that the FFTs stay off the message thread.
+struct AnalyzerThread : juce::Thread
+{
+    AnalyzerThread();
+    ~AnalyzerThread() override;
+    
+    // Once removeProducer returns, the producer isn't being processed anymore.
+    void addProducer(PathProducer* producer);
+    void removeProducer(PathProducer* producer);
+    
+    void run() override;
+    
+private:
+    static constexpr int FrameIntervalMs = (int) (1000.0 / AnalyzerFifos::ConsumerRateHz);
+    
+    juce::CriticalSection lock;
+    juce::Array<PathProducer*> producers;
 };
 
 struct ResponseCurveComponent :
@@ -271,18 +459,37 @@ public:
     void setAnalysisEnabled(bool enabled)
     {
         fftAnalysisEnabled = enabled;
+        leftChannelPathProducer.setEnabled(enabled);
+        rightChannelPathProducer.setEnabled(enabled);
+    }
+    
+    // How much consecutive analyzer windows overlap, in percent. The display
+    // rate caps the frame rate whatever the overlap.
+    void setAnalysisOverlap(float overlapPercent)
+    {
+        leftChannelPathProducer.setOverlap(overlapPercent);
+        rightChannelPathProducer.setOverlap(overlapPercent);
     }
     
 private:
     SimpleEQAudioProcessor& audioProcessor;
     
+    // Attached for as long as the component exists.
+    AnalyzerFifos& analyzerFifos;
+    
     juce::Atomic<bool> parametersChanged { false };
     
-    MonoChain monoChain;
+    ChainCoefficients chainCoefficients;
+    juce::SharedResourcePointer<CoefficientCache> coefficientCache;
     
     void updateChain();
     
+    // Shared with every other editor of the same size.
     juce::Image background;
+    juce::SharedResourcePointer<GridImageCache> gridImages;
+    juce::SharedResourcePointer<EditorFonts> fonts;
+    
+    void drawGrid(juce::Graphics& g);
     
     juce::Rectangle<int> getRenderArea();
     
@@ -290,14 +497,17 @@ private:
     
     PathProducer leftChannelPathProducer, rightChannelPathProducer;
     
-    bool fftAnalysisEnabled;
+    juce::SharedResourcePointer<AnalyzerThread> analyzerThread;
+    
+    bool fftAnalysisEnabled { true };
 };
 
 //==============================================================================
 
 /**
 */
-class SimpleEQAudioProcessorEditor : public juce::AudioProcessorEditor
+class SimpleEQAudioProcessorEditor : public juce::AudioProcessorEditor,
+                                     juce::Timer
 {
 public:
     SimpleEQAudioProcessorEditor (SimpleEQAudioProcessor&);
@@ -307,6 +517,8 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
     
+    void timerCallback() override;
+    
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
@@ -329,9 +541,13 @@ private:
     PowerButton peakBypassButton, lowCutBypassButton, highCutBypassButton;
     AnalyzerButton analyzerEnabledButton;
     
+    // DSP load of this instance, next to the analyzer button.
+    juce::Label loadMeterLabel;
+    
     ButtonAttachment peakBypassAttachment, lowCutBypassAttachment, highCutBypassAttachment, analyzerEnabledAttachment;
     
-    LookAndFeel lnf;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
+    juce::SharedResourcePointer<EditorFonts> fonts;
     
     std::vector<juce::Component*> getComps();
 
@@ -16,16 +16,19 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
 {
+    startTimerHz(LatencyPollRateHz);
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -63,7 +66,7 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return coefficientPublisher.getTailLengthSeconds();
 }
 
 int SimpleEQAudioProcessor::getNumPrograms()
@@ -95,25 +98,52 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
 {
     juce::dsp::ProcessSpec spec;
     spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
+    spec.numChannels = getTotalNumOutputChannels();
     spec.sampleRate = sampleRate;
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    if (isUsingDoublePrecision())
+    {
+        prepareFilters(doubleFilters, spec);
+    }
+    else
+    {
+        prepareFilters(floatFilters, spec);
+    }
+    
+    linearPhaseFilter.prepare(spec);
+    linearPhaseActive = false;
     
+    coefficientPublisher.prepare(sampleRate);
+    
+    // The host expects the latency to be known by the time this returns.
+    activeLatency.set(-1);
     updateFilters();
+    setLatencySamples(juce::jmax(0, activeLatency.get()));
     
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    preparedBlockSize = samplesPerBlock;
+    preparedSampleRate = sampleRate;
+    prepareAnalyzer();
     
-    osc.initialise([](float x) { return std::sin(x); });
+    loadMeter.prepare(sampleRate);
     
-    spec.numChannels = getTotalNumOutputChannels();
+    osc.initialise([](float x) { return std::sin(x); });
     
     osc.prepare(spec);
     osc.setFrequency(200);
 }
 
+template<typename FloatType>
+void SimpleEQAudioProcessor::prepareFilters(FilterStage<FloatType>& filters, const juce::dsp::ProcessSpec& spec)
+{
+    filters.prepare(spec);
+    
+    for (int factor = 0; factor < NumOversamplingFactors; factor++)
+    {
+        auto oversampling = static_cast<OversamplingFactor>(factor);
+        oversamplingLatencies[(size_t) factor] = filters.getLatencyInSamples(oversampling);
+    }
+}
+
 void SimpleEQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
@@ -127,18 +157,21 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout from mono up to MaxNumChannels, the filter engine sizes
+    // itself to the channel count in prepareToPlay.
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+    
+    if (numChannels < 1 || numChannels > MaxNumChannels)
         return false;
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+    
+    // The sidechain is optional, and can be any width up to MaxNumChannels.
+    if (layouts.inputBuses.size() > 1 && layouts.getChannelSet(true, 1).size() > MaxNumChannels)
+        return false;
    #endif
 
     return true;
@@ -147,8 +180,25 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 #endif
 
 void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, floatFilters);
+}
+
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, doubleFilters);
+}
+
+template<typename FloatType>
+void SimpleEQAudioProcessor::process(juce::AudioBuffer<FloatType>& buffer, FilterStage<FloatType>& filters)
 {
     juce::ScopedNoDenormals noDenormals;
+    
+    // Offline renders are free to allocate when they publish below.
+    RealtimeChecker::ScopedRealtimeSection realtimeSection(!isNonRealtime());
+    
+    loadMeter.blockStarted();
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -161,30 +211,189 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    updateFilters();
+    // Offline renders can't rely on the design thread keeping up.
+    if (isNonRealtime())
+    {
+        coefficientPublisher.publishIfChanged();
+    }
+    
+    filters.setSmoothing(smoothingEnabled->load() > 0.5f, smoothingInterval.get());
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    auto events = updateFilters() ? (int) LoadMeter::CoefficientUpdate : (int) LoadMeter::NoEvents;
+    
+    // Both only refer to the channels of buffer, neither allocates.
+    auto mainBuffer = getBusBuffer(buffer, true, 0);
+    juce::dsp::AudioBlock<FloatType> block(mainBuffer);
+    juce::dsp::AudioBlock<FloatType> sidechain;
+    
+    if (auto* sidechainBus = getBus(true, 1); sidechainBus != nullptr && sidechainBus->isEnabled())
+    {
+        auto sidechainBuffer = getBusBuffer(buffer, true, 1);
+        sidechain = juce::dsp::AudioBlock<FloatType>(sidechainBuffer);
+    }
     
     // OSC TEST.
     
 //    buffer.clear();
-//    
+//
 //    juce::dsp::ProcessContextReplacing<float> stereoContext(block);
 //    osc.process(stereoContext);
     
     // OSC TEST END.
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    auto inputIsSilent = isSilent(block);
+    
+    auto processed = linearPhaseActive ? linearPhaseFilter.process(block, inputIsSilent)
+                                       : filters.process(block, sidechain, inputIsSilent);
+    
+    if (processed)
+    {
+        ++numProcessedBlocks;
+    }
+    else
+    {
+        ++numSkippedBlocks;
+    }
+    
+    auto numPushed = 0;
+    
+    {
+        const juce::SpinLock::ScopedTryLockType analyzerTryLock(analyzerLock);
+        
+        if (analyzerTryLock.isLocked() && analyzerFifos != nullptr && analyzerFifos->isPrepared())
+        {
+            numPushed = analyzerFifos->left.update(mainBuffer) + analyzerFifos->right.update(mainBuffer);
+        }
+    }
+    
+    if (numPushed > 0)
+    {
+        events |= LoadMeter::AnalyzerPush;
+    }
+    
+    loadMeter.blockFinished(buffer.getNumSamples(), events);
+}
+
+template<typename FloatType>
+bool SimpleEQAudioProcessor::isSilent(const juce::dsp::AudioBlock<FloatType>& block)
+{
+    for (size_t channel = 0; channel < block.getNumChannels(); channel++)
+    {
+        auto range = juce::FloatVectorOperations::findMinAndMax(block.getChannelPointer(channel),
+                                                               (int) block.getNumSamples());
+        
+        if (juce::jmax(-range.getStart(), range.getEnd()) > static_cast<FloatType>(SilenceThreshold))
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void AnalyzerFifos::prepare(int blockSize, double sampleRate, size_t memoryBudget)
+{
+    jassert(blockSize > 0 && sampleRate > 0.0);
+    
+    const auto samplesOfSlack = sampleRate / ConsumerRateHz * FramesOfSlack;
+    auto numBuffers = (int) std::ceil(samplesOfSlack / blockSize) + 1;
+    
+    if (memoryBudget > 0)
+    {
+        // Both channels, plus the buffer each of them fills.
+        const auto bytesPerBuffer = (size_t) blockSize * sizeof(float) * 2;
+        numBuffers = juce::jmin(numBuffers, (int) (memoryBudget / bytesPerBuffer) - 1);
+    }
+    
+    overBudget = numBuffers < MinNumBuffers;
+    numBuffers = juce::jmax(MinNumBuffers, numBuffers);
+    
+    left.prepare(blockSize, numBuffers);
+    right.prepare(blockSize, numBuffers);
+}
+
+AnalyzerFifos& SimpleEQAudioProcessor::attachAnalyzer()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    if (numAnalyzerUsers++ == 0)
+    {
+        auto fifos = std::make_unique<AnalyzerFifos>();
+        
+        // Allocated before the audio thread can see it.
+        if (preparedBlockSize > 0)
+        {
+            fifos->prepare(preparedBlockSize, preparedSampleRate, analyzerMemoryBudget);
+        }
+        
+        const juce::SpinLock::ScopedLockType sl(analyzerLock);
+        analyzerFifos = std::move(fifos);
+    }
+    
+    return *analyzerFifos;
+}
+
+void SimpleEQAudioProcessor::detachAnalyzer()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    jassert(numAnalyzerUsers > 0);
+    
+    if (--numAnalyzerUsers > 0)
+    {
+        return;
+    }
+    
+    std::unique_ptr<AnalyzerFifos> fifos;
+    
+    {
+        const juce::SpinLock::ScopedLockType sl(analyzerLock);
+        fifos = std::move(analyzerFifos);
+    }
+    
+    // Freed once the audio thread can't get at it anymore.
+    fifos.reset();
+}
+
+bool SimpleEQAudioProcessor::setAnalyzerMemoryBudget(size_t bytes)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    analyzerMemoryBudget = bytes;
+    prepareAnalyzer();
+    
+    return !getMemoryUsage().analyzerOverBudget;
+}
+
+void SimpleEQAudioProcessor::prepareAnalyzer()
+{
+    // The FIFOs get resized in place, so editors can hold on to them.
+    const juce::SpinLock::ScopedLockType sl(analyzerLock);
+    
+    if (analyzerFifos != nullptr && preparedBlockSize > 0)
+    {
+        analyzerFifos->prepare(preparedBlockSize, preparedSampleRate, analyzerMemoryBudget);
+    }
+}
+
+MemoryUsage SimpleEQAudioProcessor::getMemoryUsage() const
+{
+    MemoryUsage usage;
     
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    usage.filters = floatFilters.getMemoryUsage() + doubleFilters.getMemoryUsage();
+    usage.linearPhase = linearPhaseFilter.getMemoryUsage();
+    usage.shared = CoefficientCache::getMemoryUsage();
     
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    {
+        const juce::SpinLock::ScopedLockType sl(analyzerLock);
+        
+        if (analyzerFifos != nullptr)
+        {
+            usage.analyzer = analyzerFifos->getMemoryUsage();
+            usage.analyzerOverBudget = analyzerFifos->isOverBudget();
+        }
+    }
     
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    return usage;
 }
 
 //==============================================================================
@@ -217,142 +426,1770 @@ void SimpleEQAudioProcessor::setStateInformation (const void* data, int sizeInBy
     if (tree.isValid())
     {
         apvts.replaceState(tree);
-        updateFilters();
+        coefficientPublisher.markChanged();
+    }
+}
+
+juce::String getBandParameterID(int band, const juce::String& name)
+{
+    if (band == 0)
+    {
+        return "Peak " + name;
+    }
+    
+    return "Band " + juce::String(band + 1) + " " + name;
+}
+
+static Slope getCutSlope(juce::AudioProcessorValueTreeState& apvts, const juce::String& cut)
+{
+    const auto steepSlope = static_cast<int>(apvts.getRawParameterValue(cut + " Steep Slope")->load());
+    
+    if (steepSlope > 0)
+    {
+        return static_cast<Slope>(NumOriginalSlopes + steepSlope - 1);
     }
+    
+    return static_cast<Slope>(apvts.getRawParameterValue(cut + " Slope")->load());
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts, const juce::String& prefix)
 {
     ChainSettings settings;
     
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainDecibels = apvts.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope>(apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope>(apvts.getRawParameterValue("HighCut Slope")->load());
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-    settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
-    settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
+    settings.lowCutFreq = apvts.getRawParameterValue(prefix + "LowCut Freq")->load();
+    settings.highCutFreq = apvts.getRawParameterValue(prefix + "HighCut Freq")->load();
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        auto& bandSettings = settings.bands[band];
+        
+        bandSettings.type = static_cast<BandType>(apvts.getRawParameterValue(prefix + getBandParameterID(band, "Type"))->load());
+        bandSettings.backend = static_cast<BandBackend>(apvts.getRawParameterValue(prefix + getBandParameterID(band, "Backend"))->load());
+        bandSettings.freq = apvts.getRawParameterValue(prefix + getBandParameterID(band, "Freq"))->load();
+        bandSettings.gainDecibels = apvts.getRawParameterValue(prefix + getBandParameterID(band, "Gain"))->load();
+        bandSettings.quality = apvts.getRawParameterValue(prefix + getBandParameterID(band, "Quality"))->load();
+        bandSettings.bypassed = apvts.getRawParameterValue(prefix + getBandParameterID(band, "Bypassed"))->load() > 0.5f;
+    }
+    
+    settings.dynamics.enabled = apvts.getRawParameterValue(prefix + "Peak Dynamic")->load() > 0.5f;
+    settings.dynamics.sidechain = apvts.getRawParameterValue(prefix + "Peak Sidechain")->load() > 0.5f;
+    settings.dynamics.thresholdDecibels = apvts.getRawParameterValue(prefix + "Peak Threshold")->load();
+    settings.dynamics.ratio = apvts.getRawParameterValue(prefix + "Peak Ratio")->load();
+    settings.dynamics.attackMs = apvts.getRawParameterValue(prefix + "Peak Attack")->load();
+    settings.dynamics.releaseMs = apvts.getRawParameterValue(prefix + "Peak Release")->load();
+    
+    settings.lowCutSlope = getCutSlope(apvts, prefix + "LowCut");
+    settings.highCutSlope = getCutSlope(apvts, prefix + "HighCut");
+    settings.lowCutType = static_cast<CutType>(apvts.getRawParameterValue(prefix + "LowCut Type")->load());
+    settings.highCutType = static_cast<CutType>(apvts.getRawParameterValue(prefix + "HighCut Type")->load());
+    settings.lowCutBypassed = apvts.getRawParameterValue(prefix + "LowCut Bypassed")->load() > 0.5f;
+    settings.highCutBypassed = apvts.getRawParameterValue(prefix + "HighCut Bypassed")->load() > 0.5f;
+    settings.oversampling = static_cast<OversamplingFactor>(apvts.getRawParameterValue("Oversampling")->load());
+    settings.linearPhase = apvts.getRawParameterValue("Linear Phase")->load() > 0.5f;
+    settings.linearPhaseLength = 8192 << static_cast<int>(apvts.getRawParameterValue("Linear Phase Length")->load());
+    settings.stereoMode = static_cast<StereoMode>(apvts.getRawParameterValue("Stereo Mode")->load());
+    
+    if (settings.linearPhase)
+    {
+        settings.stereoMode = StereoMode::StereoLeftRight;
+    }
     
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+bool bandSettingsDiffer(const BandSettings& a, const BandSettings& b)
+{
+    return a.type != b.type
+        || a.backend != b.backend
+        || a.freq != b.freq
+        || a.gainDecibels != b.gainDecibels
+        || a.quality != b.quality;
+}
+
+bool lowCutSettingsDiffer(const ChainSettings& a, const ChainSettings& b)
+{
+    return a.lowCutFreq != b.lowCutFreq || a.lowCutSlope != b.lowCutSlope || a.lowCutType != b.lowCutType;
+}
+
+bool highCutSettingsDiffer(const ChainSettings& a, const ChainSettings& b)
+{
+    return a.highCutFreq != b.highCutFreq || a.highCutSlope != b.highCutSlope || a.highCutType != b.highCutType;
+}
+
+void designBandCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, int band, double sampleRate,
+                            CoefficientCache* cache)
+{
+    const auto& bandSettings = chainSettings.bands[band];
+    
+    // A state variable filter only needs a tan, there's nothing to cache.
+    if (bandSettings.backend == BandBackend::SVFBackend)
+    {
+        chainCoefficients.svfBands[band] = makeSVFBand(bandSettings.type,
+                                                       sampleRate,
+                                                       bandSettings.freq,
+                                                       bandSettings.quality,
+                                                       juce::Decibels::decibelsToGain(bandSettings.gainDecibels));
+    }
+    else if (cache != nullptr)
+    {
+        chainCoefficients.bands[band] = cache->getBand(bandSettings.type,
+                                                       sampleRate,
+                                                       bandSettings.freq,
+                                                       bandSettings.quality,
+                                                       bandSettings.gainDecibels);
+    }
+    else
+    {
+        chainCoefficients.bands[band] = makeBandBiquad(bandSettings.type,
+                                                       sampleRate,
+                                                       bandSettings.freq,
+                                                       bandSettings.quality,
+                                                       juce::Decibels::decibelsToGain(bandSettings.gainDecibels));
+    }
+    
+    // Designed whether or not the band is dynamic right now, so that switching
+    // doesn't need a redesign.
+    if (band == 0)
+    {
+        const auto gainFactor = juce::Decibels::decibelsToGain(bandSettings.gainDecibels);
+        
+        chainCoefficients.dynamicBandPass = cache != nullptr
+                                          ? cache->getDynamicBandPass(sampleRate,
+                                                                      bandSettings.freq,
+                                                                      bandSettings.quality,
+                                                                      bandSettings.gainDecibels)
+                                          : makeDynamicBandPassBiquad(sampleRate, bandSettings.freq, bandSettings.quality, gainFactor);
+    }
+    
+    chainCoefficients.bandVersions[band]++;
+}
+
+void designLowCutCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate,
+                              CoefficientCache* cache)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
-                                                               chainSettings.peakQuality,
-                                                               juce::Decibels::decibelsToGain
-                                                               (chainSettings.peakGainDecibels));
+    const auto order = getSlopeOrder(chainSettings.lowCutSlope);
+    
+    if (cache != nullptr)
+    {
+        cache->getHighPass(chainCoefficients.lowCut, sampleRate, chainSettings.lowCutFreq, order, chainSettings.lowCutType);
+    }
+    else
+    {
+        designHighPass(chainCoefficients.lowCut, sampleRate, chainSettings.lowCutFreq, order, chainSettings.lowCutType);
+    }
+    
+    chainCoefficients.lowCutVersion++;
 }
 
-void SimpleEQAudioProcessor::updatePeakFilter(const ChainSettings& chainSettings)
+void designHighCutCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate,
+                               CoefficientCache* cache)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    const auto order = getSlopeOrder(chainSettings.highCutSlope);
     
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    if (cache != nullptr)
+    {
+        cache->getLowPass(chainCoefficients.highCut, sampleRate, chainSettings.highCutFreq, order, chainSettings.highCutType);
+    }
+    else
+    {
+        designLowPass(chainCoefficients.highCut, sampleRate, chainSettings.highCutFreq, order, chainSettings.highCutType);
+    }
     
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    chainCoefficients.highCutVersion++;
 }
 
-void SimpleEQAudioProcessor::updateLowCutFilter(const ChainSettings &chainSettings)
+double getChainMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, double frequency)
 {
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
+    const auto& settings = chainCoefficients.settings;
+    const auto sampleRate = chainCoefficients.sampleRate;
+    
+    auto magnitude = 1.0;
+    
+    if (sampleRate <= 0.0)
+    {
+        return magnitude;
+    }
+    
+    // A dynamic band shows its static gain.
+    if (isDynamicBandActive(settings))
+    {
+        magnitude *= getDynamicBandMagnitudeForFrequency(chainCoefficients.dynamicBandPass,
+                                                         juce::Decibels::decibelsToGain((double) settings.bands[0].gainDecibels),
+                                                         frequency,
+                                                         sampleRate);
+    }
+    
+    for (int band = isDynamicBandActive(settings) ? 1 : 0; band < MaxBands; band++)
+    {
+        if (!isBandAudible(settings.bands[band]))
+        {
+            continue;
+        }
+        
+        magnitude *= settings.bands[band].backend == BandBackend::SVFBackend
+                   ? getSVFMagnitudeForFrequency(chainCoefficients.svfBands[band], frequency, sampleRate)
+                   : getBiquadMagnitudeForFrequency(chainCoefficients.bands[band], frequency, sampleRate);
+    }
     
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+    if (!settings.lowCutBypassed)
+    {
+        for (int i = 0; i < getSlopeNumSections(settings.lowCutSlope); i++)
+        {
+            magnitude *= getBiquadMagnitudeForFrequency(chainCoefficients.lowCut[i], frequency, sampleRate);
+        }
+    }
     
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    if (!settings.highCutBypassed)
+    {
+        for (int i = 0; i < getSlopeNumSections(settings.highCutSlope); i++)
+        {
+            magnitude *= getBiquadMagnitudeForFrequency(chainCoefficients.highCut[i], frequency, sampleRate);
+        }
+    }
     
-    updateCutCoefficients(leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutCoefficients(rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    return magnitude;
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilter(const ChainSettings &chainSettings)
+double getChainTailLengthSeconds(const ChainCoefficients& chainCoefficients)
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
+    const auto& settings = chainCoefficients.settings;
+    
+    if (chainCoefficients.sampleRate <= 0.0)
+    {
+        return 0.0;
+    }
+    
+    // The linear phase kernel is as long as it gets.
+    if (settings.linearPhase)
+    {
+        return settings.linearPhaseLength / (chainCoefficients.sampleRate / (1 << settings.oversampling));
+    }
+    
+    // Sections run one after the other, so their tails add up.
+    constexpr auto decayDecibels = 120.0;
+    auto numSamples = 0.0;
+    
+    if (isDynamicBandActive(settings))
+    {
+        numSamples += getBiquadDecayInSamples(chainCoefficients.dynamicBandPass, decayDecibels);
+    }
+    
+    for (int band = isDynamicBandActive(settings) ? 1 : 0; band < MaxBands; band++)
+    {
+        if (!isBandAudible(settings.bands[band]))
+        {
+            continue;
+        }
+        
+        numSamples += getBiquadDecayInSamples(settings.bands[band].backend == BandBackend::SVFBackend
+                                              ? makeBiquadFromSVF(chainCoefficients.svfBands[band])
+                                              : chainCoefficients.bands[band],
+                                              decayDecibels);
+    }
     
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
+    if (!settings.lowCutBypassed)
+    {
+        for (int i = 0; i < getSlopeNumSections(settings.lowCutSlope); i++)
+        {
+            numSamples += getBiquadDecayInSamples(chainCoefficients.lowCut[i], decayDecibels);
+        }
+    }
     
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    if (!settings.highCutBypassed)
+    {
+        for (int i = 0; i < getSlopeNumSections(settings.highCutSlope); i++)
+        {
+            numSamples += getBiquadDecayInSamples(chainCoefficients.highCut[i], decayDecibels);
+        }
+    }
     
-    updateCutCoefficients(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutCoefficients(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    return numSamples / chainCoefficients.sampleRate;
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate, CoefficientCache* cache)
 {
-    auto chainSettings = getChainSettings(apvts);
-    updatePeakFilter(chainSettings);
-    updateLowCutFilter(chainSettings);
-    updateHighCutFilter(chainSettings);
+    ChainCoefficients chainCoefficients;
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        designBandCoefficients(chainCoefficients, chainSettings, band, sampleRate, cache);
+    }
+    
+    designLowCutCoefficients(chainCoefficients, chainSettings, sampleRate, cache);
+    designHighCutCoefficients(chainCoefficients, chainSettings, sampleRate, cache);
+    
+    chainCoefficients.settings = chainSettings;
+    chainCoefficients.sampleRate = sampleRate;
+    
+    return chainCoefficients;
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+bool SimpleEQAudioProcessor::updateFilters()
 {
-    *old = *replacements;
+    // Only picks up what the design thread has published, never designs.
+    if (!coefficientPublisher.pull())
+    {
+        return false;
+    }
+    
+    // Whichever path takes over starts from a clean state.
+    auto linearPhase = coefficientPublisher.getCoefficients().main.settings.linearPhase;
+    
+    if (linearPhase != linearPhaseActive)
+    {
+        linearPhaseActive = linearPhase;
+        
+        if (linearPhaseActive)
+        {
+            linearPhaseFilter.reset();
+        }
+        else if (isUsingDoublePrecision())
+        {
+            doubleFilters.reset();
+        }
+        else
+        {
+            floatFilters.reset();
+        }
+    }
+    
+    if (isUsingDoublePrecision())
+    {
+        doubleFilters.setCoefficients(coefficientPublisher.getCoefficients());
+    }
+    else
+    {
+        floatFilters.setCoefficients(coefficientPublisher.getCoefficients());
+    }
+    
+    // Both the linear phase filter and the oversamplers have switched by now.
+    const auto& settings = coefficientPublisher.getCoefficients().main.settings;
+    
+    auto latency = settings.linearPhase ? LinearPhaseFilter::getLatencyInSamples(settings.linearPhaseLength)
+                                        : oversamplingLatencies[(size_t) settings.oversampling];
+    
+    activeLatency.set(latency);
+    
+    return true;
 }
 
-juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::createParameterLayout()
+void SimpleEQAudioProcessor::timerCallback()
 {
-    juce::AudioProcessorValueTreeState::ParameterLayout parameterLayout;
+    auto latency = activeLatency.get();
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "LowCut Freq", 1 },
-                                                                    "LowCut Freq",
-                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
-                                                                    20.f));
+    if (latency >= 0 && latency != getLatencySamples())
+    {
+        setLatencySamples(latency);
+    }
+}
+
+//==============================================================================
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    // One group of SIMD lanes per getNumLanes() channels.
+    numChannels = (size_t) spec.numChannels;
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "HighCut Freq", 1 },
-                                                                    "HighCut Freq",
-                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
-                                                                    20000.f));
+    const auto numGroups = juce::jmax((size_t) 1, (numChannels + getNumLanes() - 1) / getNumLanes());
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "Peak Freq", 1 },
-                                                                    "Peak Freq",
-                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
-                                                                    750.f));
+    cascades.resize(numGroups);
+    svfCascades.resize(numGroups);
+    dynamicBands.resize(numGroups);
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "Peak Gain", 1 },
-                                                                    "Peak Gain",
-                                                                    juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
-                                                                    0.f));
+    setSampleRate(spec.sampleRate);
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { "Peak Quality", 1 },
-                                                                    "Peak Quality",
-                                                                    juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
-                                                                    1.f));
+    interleaved = juce::dsp::AudioBlock<SIMDSample>(interleavedData, numGroups, spec.maximumBlockSize);
+    interleavedSidechain = juce::dsp::AudioBlock<SIMDSample>(interleavedSidechainData, numGroups, spec.maximumBlockSize);
     
-    juce::StringArray filterSlopeOptions;
+    // Lanes without a channel behind them stay silent from here on.
+    for (size_t group = 0; group < numGroups; group++)
+    {
+        juce::FloatVectorOperations::clear(reinterpret_cast<FloatType*>(interleaved.getChannelPointer(group)),
+                                           (int) (spec.maximumBlockSize * getNumLanes()));
+        juce::FloatVectorOperations::clear(reinterpret_cast<FloatType*>(interleavedSidechain.getChannelPointer(group)),
+                                           (int) (spec.maximumBlockSize * getNumLanes()));
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::reset()
+{
+    for (auto& cascade : cascades)
+    {
+        cascade.reset();
+    }
     
-    for (int i = 0; i < 4; i++)
+    for (auto& svfCascade : svfCascades)
     {
-        juce::String option;
-        option << (12 + i * 12);
-        option << " dB/Oct";
-        filterSlopeOptions.add(option);
+        svfCascade.reset();
     }
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "LowCut Slope", 1 },
-                                                                     "LowCut Slope",
-                                                                     filterSlopeOptions,
-                                                                     0));
+    for (auto& dynamicBand : dynamicBands)
+    {
+        dynamicBand.reset();
+    }
+    
+    // Lanes whose channel stopped being passed in (see FilterStage) would
+    // otherwise keep getting fed whatever they held last.
+    for (size_t group = 0; group < interleaved.getNumChannels(); group++)
+    {
+        juce::FloatVectorOperations::clear(reinterpret_cast<FloatType*>(interleaved.getChannelPointer(group)),
+                                           (int) (interleaved.getNumSamples() * getNumLanes()));
+    }
+}
 
-    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "HighCut Slope", 1 },
-                                                                     "HighCut Slope",
-                                                                     filterSlopeOptions,
+template<typename FloatType>
+size_t SIMDFilterEngine<FloatType>::getMemoryUsage() const
+{
+    const auto numGroups = cascades.size();
+    const auto interleavedBytes = interleaved.getNumChannels() * interleaved.getNumSamples() * sizeof(SIMDSample);
+    
+    return interleavedBytes * 2
+         + numGroups * (sizeof(cascades[0]) + sizeof(svfCascades[0]) + sizeof(dynamicBands[0]));
+}
+
+template<typename FloatType>
+bool SIMDFilterEngine<FloatType>::hasDecayed(FloatType threshold) const
+{
+    for (const auto& cascade : cascades)
+    {
+        if (!cascade.hasDecayed(threshold))
+        {
+            return false;
+        }
+    }
+    
+    for (const auto& svfCascade : svfCascades)
+    {
+        if (!svfCascade.hasDecayed(threshold))
+        {
+            return false;
+        }
+    }
+    
+    if (dynamicActive)
+    {
+        for (const auto& dynamicBand : dynamicBands)
+        {
+            if (!dynamicBand.hasDecayed(threshold))
+            {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setCoefficients(const ChainCoefficients& chainCoefficients)
+{
+    if (chainCoefficients.sampleRate != sampleRate)
+    {
+        setSampleRate(chainCoefficients.sampleRate);
+    }
+    
+    target = chainCoefficients;
+    
+    // Before the bands, band 0 leaves the cascade while it is dynamic.
+    updateDynamicBand();
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        updateBandFilter(target, band);
+    }
+    
+    updateLowCutFilter(target);
+    updateHighCutFilter(target);
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSampleRate(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    
+    for (auto& dynamicBand : dynamicBands)
+    {
+        dynamicBand.prepare(sampleRate);
+    }
+    
+    // The old states and ramps mean nothing at the new rate, start over.
+    reset();
+    
+    appliedBandVersions.fill(-1);
+    appliedLowCutVersion = -1;
+    appliedHighCutVersion = -1;
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        bandFreqs[band].reset(sampleRate, SmoothingTimeSeconds);
+        bandGains[band].reset(sampleRate, SmoothingTimeSeconds);
+        bandQualities[band].reset(sampleRate, SmoothingTimeSeconds);
+    }
+    
+    lowCutFreq.reset(sampleRate, SmoothingTimeSeconds);
+    highCutFreq.reset(sampleRate, SmoothingTimeSeconds);
+    
+    bandRamping.fill(false);
+    numRampingBands = 0;
+    lowCutRamping = false;
+    highCutRamping = false;
+    samplesUntilUpdate = 0;
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSmoothing(bool shouldSmooth, int intervalInSamples)
+{
+    smoothingEnabled = shouldSmooth;
+    
+    // Turning smoothing off jumps straight to whatever is still ramping.
+    if (!smoothingEnabled && isSmoothing())
+    {
+        for (int band = 0; band < MaxBands; band++)
+        {
+            bandFreqs[band].setCurrentAndTargetValue(bandFreqs[band].getTargetValue());
+            bandGains[band].setCurrentAndTargetValue(bandGains[band].getTargetValue());
+            bandQualities[band].setCurrentAndTargetValue(bandQualities[band].getTargetValue());
+        }
+        
+        lowCutFreq.setCurrentAndTargetValue(lowCutFreq.getTargetValue());
+        highCutFreq.setCurrentAndTargetValue(highCutFreq.getTargetValue());
+        
+        updateSmoothedFilters();
+    }
+    
+    if (smoothingInterval != intervalInSamples)
+    {
+        smoothingInterval = intervalInSamples;
+        samplesUntilUpdate = 0;
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::process(const juce::dsp::AudioBlock<FloatType>& block,
+                                         const juce::dsp::AudioBlock<FloatType>& sidechain)
+{
+    const auto numSamples = block.getNumSamples();
+    const auto numBlockChannels = juce::jmin(block.getNumChannels(), numChannels);
+    const auto numLanes = getNumLanes();
+    
+    jassert(numSamples <= interleaved.getNumSamples());
+    jassert(block.getNumChannels() <= numChannels);
+    
+    // Interleave.
+    for (size_t channel = 0; channel < numBlockChannels; channel++)
+    {
+        auto* channelSamples = block.getChannelPointer(channel);
+        auto* interleavedSamples = reinterpret_cast<FloatType*>(interleaved.getChannelPointer(channel / numLanes));
+        const auto lane = channel % numLanes;
+        
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            interleavedSamples[i * numLanes + lane] = channelSamples[i];
+        }
+    }
+    
+    sidechainActive = dynamicActive && target.settings.dynamics.sidechain && sidechain.getNumChannels() > 0;
+    
+    if (sidechainActive)
+    {
+        interleaveSidechain(sidechain, numSamples);
+    }
+    
+    // Filter every group of channels, running every active section per sample.
+    if (isSmoothing())
+    {
+        size_t start = 0;
+        
+        while (start < numSamples)
+        {
+            if (samplesUntilUpdate == 0)
+            {
+                updateSmoothedFilters();
+                samplesUntilUpdate = smoothingInterval;
+            }
+            
+            auto numToProcess = juce::jmin(numSamples - start, (size_t) samplesUntilUpdate);
+            
+            processGroups(start, numToProcess);
+            
+            start += numToProcess;
+            samplesUntilUpdate -= (int) numToProcess;
+        }
+    }
+    else
+    {
+        processGroups(0, numSamples);
+        samplesUntilUpdate = 0;
+    }
+    
+    // Deinterleave.
+    for (size_t channel = 0; channel < numBlockChannels; channel++)
+    {
+        auto* channelSamples = block.getChannelPointer(channel);
+        auto* interleavedSamples = reinterpret_cast<const FloatType*>(interleaved.getChannelPointer(channel / numLanes));
+        const auto lane = channel % numLanes;
+        
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            channelSamples[i] = interleavedSamples[i * numLanes + lane];
+        }
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::interleaveSidechain(const juce::dsp::AudioBlock<FloatType>& sidechain, size_t numSamples)
+{
+    const auto numLanes = getNumLanes();
+    const auto numSidechainChannels = sidechain.getNumChannels();
+    const auto numSidechainSamples = juce::jmax((size_t) 1, sidechain.getNumSamples());
+    const auto hold = juce::jmax((size_t) 1, numSamples / numSidechainSamples);
+    
+    jassert(numSamples <= numSidechainSamples * hold);
+    
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+        auto* sidechainSamples = sidechain.getChannelPointer(juce::jmin(channel, numSidechainChannels - 1));
+        auto* interleavedSamples = reinterpret_cast<FloatType*>(interleavedSidechain.getChannelPointer(channel / numLanes));
+        const auto lane = channel % numLanes;
+        
+        for (size_t i = 0; i < numSamples; i++)
+        {
+            interleavedSamples[i * numLanes + lane] = sidechainSamples[i / hold];
+        }
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::processGroups(size_t startSample, size_t numSamples)
+{
+    for (size_t group = 0; group < cascades.size(); group++)
+    {
+        auto* samples = interleaved.getChannelPointer(group) + startSample;
+        
+        cascades[group].process(samples, numSamples);
+        
+        if (svfCascades[group].getNumActiveSections() > 0)
+        {
+            svfCascades[group].process(samples, numSamples);
+        }
+        
+        if (dynamicActive)
+        {
+            dynamicBands[group].process(samples,
+                                        sidechainActive ? interleavedSidechain.getChannelPointer(group) + startSample : nullptr,
+                                        numSamples);
+        }
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSectionCoefficients(int section, const BiquadCoefficients& coefficients)
+{
+    for (auto& cascade : cascades)
+    {
+        cascade.setCoefficients(section, coefficients);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSectionActive(int section, bool shouldBeActive)
+{
+    for (auto& cascade : cascades)
+    {
+        cascade.setActive(section, shouldBeActive);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSVFCoefficients(int band, const SVFCoefficients& coefficients, int numSteps)
+{
+    for (auto& svfCascade : svfCascades)
+    {
+        svfCascade.setCoefficients(band, coefficients, numSteps);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setSVFActive(int band, bool shouldBeActive)
+{
+    for (auto& svfCascade : svfCascades)
+    {
+        svfCascade.setActive(band, shouldBeActive);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateCutSections(int firstSection,
+                                                    const std::array<BiquadCoefficients, MaxCutSections>& coefficients,
+                                                    Slope slope,
+                                                    bool bypassed,
+                                                    bool coefficientsChanged)
+{
+    // Slope_12 needs one section, Slope_96 all eight.
+    const int numSections = getSlopeNumSections(slope);
+    
+    for (int i = 0; i < (int) coefficients.size(); i++)
+    {
+        if (coefficientsChanged && i < numSections)
+        {
+            setSectionCoefficients(firstSection + i, coefficients[i]);
+        }
+        
+        setSectionActive(firstSection + i, !bypassed && i < numSections);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateBandFilter(const ChainCoefficients& chainCoefficients, int band)
+{
+    const auto& settings = chainCoefficients.settings.bands[band];
+    
+    if (chainCoefficients.bandVersions[band] != appliedBandVersions[band])
+    {
+        // A new type or backend is a different filter altogether, so it can't be ramped.
+        auto shouldRamp = smoothingEnabled
+                       && appliedBandVersions[band] >= 0
+                       && settings.type == appliedBandTypes[band]
+                       && settings.backend == appliedBandBackends[band];
+        
+        if (shouldRamp)
+        {
+            bandFreqs[band].setTargetValue(settings.freq);
+            bandGains[band].setTargetValue(settings.gainDecibels);
+            bandQualities[band].setTargetValue(settings.quality);
+            setBandRamping(band, true);
+        }
+        else
+        {
+            bandFreqs[band].setCurrentAndTargetValue(settings.freq);
+            bandGains[band].setCurrentAndTargetValue(settings.gainDecibels);
+            bandQualities[band].setCurrentAndTargetValue(settings.quality);
+            setBandRamping(band, false);
+            
+            if (settings.backend == BandBackend::SVFBackend)
+            {
+                setSVFCoefficients(band, chainCoefficients.svfBands[band], 0);
+            }
+            else
+            {
+                setSectionCoefficients(CascadeSections::BandSection + band, chainCoefficients.bands[band]);
+            }
+            
+            if (band == 0)
+            {
+                setDynamicBandPass(chainCoefficients.dynamicBandPass, settings.gainDecibels);
+            }
+        }
+        
+        appliedBandVersions[band] = chainCoefficients.bandVersions[band];
+        appliedBandTypes[band] = settings.type;
+        appliedBandBackends[band] = settings.backend;
+    }
+    
+    updateBandActive(band);
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setBandRamping(int band, bool shouldRamp)
+{
+    if (bandRamping[band] != shouldRamp)
+    {
+        bandRamping[band] = shouldRamp;
+        numRampingBands += shouldRamp ? 1 : -1;
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateBandActive(int band)
+{
+    // Leave a neutral band out, unless it is still on its way there.
+    const auto& settings = target.settings.bands[band];
+    
+    const auto active = !settings.bypassed && (bandRamping[band] || !isBandNeutral(settings)) && !(band == 0 && dynamicActive);
+    const auto usesSVF = settings.backend == BandBackend::SVFBackend;
+    
+    setSectionActive(CascadeSections::BandSection + band, active && !usesSVF);
+    setSVFActive(band, active && usesSVF);
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateDynamicBand()
+{
+    const auto active = isDynamicBandActive(target.settings);
+    
+    // Same as a section coming back, it shouldn't ring out what it held before.
+    if (active && !dynamicActive)
+    {
+        for (auto& dynamicBand : dynamicBands)
+        {
+            dynamicBand.reset();
+        }
+    }
+    
+    dynamicActive = active;
+    
+    for (auto& dynamicBand : dynamicBands)
+    {
+        dynamicBand.setParameters(target.settings.dynamics);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::setDynamicBandPass(const BiquadCoefficients& bandPass, float staticGainDecibels)
+{
+    for (auto& dynamicBand : dynamicBands)
+    {
+        dynamicBand.setBandPass(bandPass);
+        dynamicBand.setStaticGain(staticGainDecibels);
+    }
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateLowCutFilter(const ChainCoefficients& chainCoefficients)
+{
+    const auto& settings = chainCoefficients.settings;
+    
+    auto changed = chainCoefficients.lowCutVersion != appliedLowCutVersion;
+    
+    // A new slope or type changes the sections themselves, so it can't be ramped.
+    auto shouldRamp = changed
+                   && smoothingEnabled
+                   && appliedLowCutVersion >= 0
+                   && settings.lowCutSlope == appliedLowCutSlope
+                   && settings.lowCutType == appliedLowCutType;
+    
+    if (shouldRamp)
+    {
+        lowCutFreq.setTargetValue(settings.lowCutFreq);
+        lowCutRamping = true;
+    }
+    else if (changed)
+    {
+        lowCutFreq.setCurrentAndTargetValue(settings.lowCutFreq);
+        lowCutRamping = false;
+    }
+    
+    updateCutSections(CascadeSections::LowCutSection,
+                      chainCoefficients.lowCut,
+                      settings.lowCutSlope,
+                      settings.lowCutBypassed,
+                      changed && !shouldRamp);
+    
+    appliedLowCutVersion = chainCoefficients.lowCutVersion;
+    appliedLowCutSlope = settings.lowCutSlope;
+    appliedLowCutType = settings.lowCutType;
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateHighCutFilter(const ChainCoefficients& chainCoefficients)
+{
+    const auto& settings = chainCoefficients.settings;
+    
+    auto changed = chainCoefficients.highCutVersion != appliedHighCutVersion;
+    
+    // A new slope or type changes the sections themselves, so it can't be ramped.
+    auto shouldRamp = changed
+                   && smoothingEnabled
+                   && appliedHighCutVersion >= 0
+                   && settings.highCutSlope == appliedHighCutSlope
+                   && settings.highCutType == appliedHighCutType;
+    
+    if (shouldRamp)
+    {
+        highCutFreq.setTargetValue(settings.highCutFreq);
+        highCutRamping = true;
+    }
+    else if (changed)
+    {
+        highCutFreq.setCurrentAndTargetValue(settings.highCutFreq);
+        highCutRamping = false;
+    }
+    
+    updateCutSections(CascadeSections::HighCutSection,
+                      chainCoefficients.highCut,
+                      settings.highCutSlope,
+                      settings.highCutBypassed,
+                      changed && !shouldRamp);
+    
+    appliedHighCutVersion = chainCoefficients.highCutVersion;
+    appliedHighCutSlope = settings.highCutSlope;
+    appliedHighCutType = settings.highCutType;
+}
+
+template<typename FloatType>
+void SIMDFilterEngine<FloatType>::updateSmoothedFilters()
+{
+    const auto& settings = target.settings;
+    
+    for (int band = 0; band < MaxBands && numRampingBands > 0; band++)
+    {
+        if (!bandRamping[band])
+        {
+            continue;
+        }
+        
+        if (bandFreqs[band].isSmoothing() || bandGains[band].isSmoothing() || bandQualities[band].isSmoothing())
+        {
+            auto freq = bandFreqs[band].skip(smoothingInterval);
+            auto gain = bandGains[band].skip(smoothingInterval);
+            auto quality = bandQualities[band].skip(smoothingInterval);
+            
+            const auto& bandSettings = settings.bands[band];
+            
+            // State variable filters glide there over the interval, biquads jump.
+            if (bandSettings.backend == BandBackend::SVFBackend)
+            {
+                setSVFCoefficients(band,
+                                   makeSVFBand(bandSettings.type, sampleRate, freq, quality, juce::Decibels::decibelsToGain(gain)),
+                                   smoothingInterval);
+            }
+            else
+            {
+                setSectionCoefficients(CascadeSections::BandSection + band,
+                                       makeBandBiquad(bandSettings.type,
+                                                      sampleRate,
+                                                      freq,
+                                                      quality,
+                                                      juce::Decibels::decibelsToGain(gain)));
+            }
+            
+            if (band == 0)
+            {
+                setDynamicBandPass(makeDynamicBandPassBiquad(sampleRate, freq, quality, juce::Decibels::decibelsToGain(gain)), gain);
+            }
+        }
+        else
+        {
+            // Settled, so switch to the exact design that was published.
+            if (settings.bands[band].backend == BandBackend::SVFBackend)
+            {
+                setSVFCoefficients(band, target.svfBands[band], 0);
+            }
+            else
+            {
+                setSectionCoefficients(CascadeSections::BandSection + band, target.bands[band]);
+            }
+            
+            setBandRamping(band, false);
+            
+            if (band == 0)
+            {
+                setDynamicBandPass(target.dynamicBandPass, settings.bands[0].gainDecibels);
+            }
+            
+            updateBandActive(band);
+        }
+    }
+    
+    std::array<BiquadCoefficients, MaxCutSections> sections;
+    
+    if (lowCutRamping)
+    {
+        if (lowCutFreq.isSmoothing())
+        {
+            designHighPass(sections,
+                           sampleRate,
+                           lowCutFreq.skip(smoothingInterval),
+                           getSlopeOrder(settings.lowCutSlope),
+                           settings.lowCutType);
+        }
+        else
+        {
+            sections = target.lowCut;
+            lowCutRamping = false;
+        }
+        
+        updateCutSections(CascadeSections::LowCutSection, sections, settings.lowCutSlope, settings.lowCutBypassed, true);
+    }
+    
+    if (highCutRamping)
+    {
+        if (highCutFreq.isSmoothing())
+        {
+            designLowPass(sections,
+                          sampleRate,
+                          highCutFreq.skip(smoothingInterval),
+                          getSlopeOrder(settings.highCutSlope),
+                          settings.highCutType);
+        }
+        else
+        {
+            sections = target.highCut;
+            highCutRamping = false;
+        }
+        
+        updateCutSections(CascadeSections::HighCutSection, sections, settings.highCutSlope, settings.highCutBypassed, true);
+    }
+}
+
+template struct SIMDFilterEngine<float>;
+template struct SIMDFilterEngine<double>;
+
+//==============================================================================
+
+template<typename FloatType>
+void FilterStage<FloatType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    for (int factor = OversamplingFactor::Oversampling_2x; factor < NumOversamplingFactors; factor++)
+    {
+        using Oversampling = juce::dsp::Oversampling<FloatType>;
+        
+        oversamplers[factor] = std::make_unique<Oversampling>(spec.numChannels,
+                                                              factor,
+                                                              Oversampling::filterHalfBandPolyphaseIIR,
+                                                              true,  // isMaxQuality
+                                                              true); // useIntegerLatency
+        oversamplers[factor]->initProcessing(spec.maximumBlockSize);
+    }
+    
+    activeOversampling = OversamplingFactor::Oversampling_1x;
+    
+    auto engineSpec = spec;
+    engineSpec.maximumBlockSize = spec.maximumBlockSize << (NumOversamplingFactors - 1);
+    
+    engine.prepare(engineSpec);
+    
+    engineSpec.numChannels = 1;
+    sideEngine.prepare(engineSpec);
+    
+    preparedSpec = spec;
+}
+
+template<typename FloatType>
+void FilterStage<FloatType>::reset()
+{
+    engine.reset();
+    sideEngine.reset();
+    
+    for (auto& oversampler : oversamplers)
+    {
+        if (oversampler != nullptr)
+        {
+            oversampler->reset();
+        }
+    }
+}
+
+template<typename FloatType>
+void FilterStage<FloatType>::setCoefficients(const StereoChainCoefficients& stereoCoefficients)
+{
+    const auto& chainCoefficients = stereoCoefficients.main;
+    
+    // Every engine gets a different channel in every mode, none of them
+    // should carry over what it held.
+    if (chainCoefficients.settings.stereoMode != stereoMode)
+    {
+        stereoMode = chainCoefficients.settings.stereoMode;
+        engine.reset();
+        sideEngine.reset();
+    }
+    
+    // Switch factors together with the coefficients designed for it.
+    if (chainCoefficients.settings.oversampling != activeOversampling)
+    {
+        activeOversampling = chainCoefficients.settings.oversampling;
+        
+        if (auto& oversampler = oversamplers[activeOversampling])
+        {
+            oversampler->reset();
+        }
+    }
+    
+    engine.setCoefficients(chainCoefficients);
+    
+    // The side coefficients are stale in every other mode.
+    if (stereoMode == StereoMode::StereoMidSide)
+    {
+        sideEngine.setCoefficients(stereoCoefficients.side);
+    }
+}
+
+template<typename FloatType>
+bool FilterStage<FloatType>::process(juce::dsp::AudioBlock<FloatType>& block,
+                                     const juce::dsp::AudioBlock<FloatType>& sidechain,
+                                     bool inputIsSilent)
+{
+    // Ramps keep running in real time, so nothing gets skipped while smoothing.
+    if (inputIsSilent && !isSmoothing() && hasDecayed())
+    {
+        // Whatever is left is below the threshold, start from scratch once
+        // there is signal again.
+        if (!skippingSilence)
+        {
+            reset();
+            skippingSilence = true;
+        }
+        
+        return false;
+    }
+    
+    skippingSilence = false;
+    
+    // Both transforms are linear, so they can stay outside the oversamplers
+    // and run at the lower rate.
+    const auto midSide = stereoMode != StereoMode::StereoLeftRight && block.getNumChannels() == 2;
+    
+    if (midSide)
+    {
+        encodeMidSide(block);
+    }
+    
+    if (activeOversampling == OversamplingFactor::Oversampling_1x)
+    {
+        processEngines(block, sidechain);
+    }
+    else
+    {
+        auto& oversampler = *oversamplers[activeOversampling];
+        
+        processEngines(oversampler.processSamplesUp(block), sidechain);
+        oversampler.processSamplesDown(block);
+    }
+    
+    if (midSide)
+    {
+        decodeMidSide(block);
+    }
+    
+    return true;
+}
+
+template<typename FloatType>
+void FilterStage<FloatType>::processEngines(const juce::dsp::AudioBlock<FloatType>& block,
+                                            const juce::dsp::AudioBlock<FloatType>& sidechain)
+{
+    if (stereoMode == StereoMode::StereoLeftRight || block.getNumChannels() != 2)
+    {
+        engine.process(block, sidechain);
+        return;
+    }
+    
+    // The detector of each engine listens to the sidechain channel with the
+    // same index as the channel it filters, as it would in left/right mode.
+    auto getSidechain = [&sidechain](size_t channel)
+    {
+        if (sidechain.getNumChannels() == 0)
+        {
+            return sidechain;
+        }
+        
+        return sidechain.getSingleChannelBlock(juce::jmin(channel, sidechain.getNumChannels() - 1));
+    };
+    
+    switch (stereoMode)
+    {
+        case StereoMode::StereoMidSide:
+            engine.process(block.getSingleChannelBlock(0), getSidechain(0));
+            sideEngine.process(block.getSingleChannelBlock(1), getSidechain(1));
+            break;
+        
+        case StereoMode::StereoMidOnly:
+            engine.process(block.getSingleChannelBlock(0), getSidechain(0));
+            break;
+        
+        case StereoMode::StereoSideOnly:
+            engine.process(block.getSingleChannelBlock(1), getSidechain(1));
+            break;
+        
+        case StereoMode::StereoLeftRight:
+        case StereoMode::NumStereoModes:
+        default:
+            break;
+    }
+}
+
+template<typename FloatType>
+void FilterStage<FloatType>::encodeMidSide(juce::dsp::AudioBlock<FloatType>& block)
+{
+    auto* left = block.getChannelPointer(0);
+    auto* right = block.getChannelPointer(1);
+    const auto half = static_cast<FloatType>(0.5);
+    
+    // Simple enough for the compiler to vectorise.
+    for (size_t i = 0; i < block.getNumSamples(); i++)
+    {
+        const auto l = left[i];
+        const auto r = right[i];
+        
+        left[i] = (l + r) * half;
+        right[i] = (l - r) * half;
+    }
+}
+
+template<typename FloatType>
+void FilterStage<FloatType>::decodeMidSide(juce::dsp::AudioBlock<FloatType>& block)
+{
+    auto* mid = block.getChannelPointer(0);
+    auto* side = block.getChannelPointer(1);
+    
+    for (size_t i = 0; i < block.getNumSamples(); i++)
+    {
+        const auto m = mid[i];
+        const auto s = side[i];
+        
+        mid[i] = m + s;
+        side[i] = m - s;
+    }
+}
+
+template<typename FloatType>
+bool FilterStage<FloatType>::isSmoothing() const
+{
+    return engine.isSmoothing() || (stereoMode == StereoMode::StereoMidSide && sideEngine.isSmoothing());
+}
+
+template<typename FloatType>
+bool FilterStage<FloatType>::hasDecayed() const
+{
+    const auto threshold = static_cast<FloatType>(SimpleEQAudioProcessor::SilenceThreshold);
+    
+    return engine.hasDecayed(threshold) && (stereoMode != StereoMode::StereoMidSide || sideEngine.hasDecayed(threshold));
+}
+
+template<typename FloatType>
+size_t FilterStage<FloatType>::getMemoryUsage() const
+{
+    auto bytes = engine.getMemoryUsage() + sideEngine.getMemoryUsage();
+    
+    // Every stage of an oversampler buffers its output, at twice the rate of
+    // the stage before it.
+    const auto blockBytes = (size_t) preparedSpec.numChannels * preparedSpec.maximumBlockSize * sizeof(FloatType);
+    
+    for (int factor = OversamplingFactor::Oversampling_2x; factor < NumOversamplingFactors; factor++)
+    {
+        if (oversamplers[factor] != nullptr)
+        {
+            for (int stage = 1; stage <= factor; stage++)
+            {
+                bytes += blockBytes << stage;
+            }
+        }
+    }
+    
+    return bytes;
+}
+
+template<typename FloatType>
+int FilterStage<FloatType>::getLatencyInSamples(OversamplingFactor factor) const
+{
+    if (auto& oversampler = oversamplers[factor])
+    {
+        return juce::roundToInt(oversampler->getLatencyInSamples());
+    }
+    
+    return 0;
+}
+
+template struct FilterStage<float>;
+template struct FilterStage<double>;
+
+//==============================================================================
+
+CoefficientDesignThread::CoefficientDesignThread() : juce::Thread("SimpleEQ Coefficient Design")
+{
+    startThread();
+}
+
+CoefficientDesignThread::~CoefficientDesignThread()
+{
+    stopThread(1000);
+}
+
+void CoefficientDesignThread::addPublisher(CoefficientPublisher* publisher)
+{
+    const juce::ScopedLock sl(lock);
+    publishers.addIfNotAlreadyThere(publisher);
+}
+
+void CoefficientDesignThread::removePublisher(CoefficientPublisher* publisher)
+{
+    const juce::ScopedLock sl(lock);
+    publishers.removeFirstMatchingValue(publisher);
+    
+    // The publisher is about to go away, so its design has to finish first.
+    while (activePublisher == publisher)
+    {
+        const juce::ScopedUnlock sul(lock);
+        activePublisherDone.wait(PollIntervalMs);
+    }
+}
+
+void CoefficientDesignThread::run()
+{
+    while (!threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(lock);
+            pendingPublishers.clearQuick();
+            pendingPublishers.addArray(publishers);
+        }
+        
+        for (auto* publisher : pendingPublishers)
+        {
+            {
+                // It may have been removed since the list was copied.
+                const juce::ScopedLock sl(lock);
+                
+                if (!publishers.contains(publisher))
+                {
+                    continue;
+                }
+                
+                activePublisher = publisher;
+            }
+            
+            publisher->publishIfChanged();
+            
+            {
+                const juce::ScopedLock sl(lock);
+                activePublisher = nullptr;
+            }
+            
+            activePublisherDone.signal();
+        }
+        
+        wait(PollIntervalMs);
+    }
+}
+
+//==============================================================================
+
+CoefficientPublisher::CoefficientPublisher(juce::AudioProcessor& p,
+                                           juce::AudioProcessorValueTreeState& state,
+                                           LinearPhaseFilter& filter) :
+processor(p),
+apvts(state),
+linearPhaseFilter(filter)
+{
+    for (auto* param : processor.getParameters())
+    {
+        param->addListener(this);
+    }
+    
+    designThread->addPublisher(this);
+}
+
+CoefficientPublisher::~CoefficientPublisher()
+{
+    designThread->removePublisher(this);
+    
+    for (auto* param : processor.getParameters())
+    {
+        param->removeListener(this);
+    }
+}
+
+void CoefficientPublisher::prepare(double newSampleRate)
+{
+    {
+        // Forces every band to be redesigned, even if the rate is unchanged.
+        const juce::ScopedLock sl(writeLock);
+        lastSampleRate = 0.0;
+    }
+    
+    sampleRate.set(newSampleRate);
+    parametersChanged.set(false);
+    publish();
+}
+
+void CoefficientPublisher::publish()
+{
+    const juce::ScopedLock sl(writeLock);
+    
+    auto currentSampleRate = sampleRate.get();
+    
+    if (currentSampleRate <= 0.0)
+    {
+        return;
+    }
+    
+    auto chainSettings = getChainSettings(apvts);
+    
+    // Everything gets designed at the rate the filters will actually run at.
+    currentSampleRate = getOversampledRate(currentSampleRate, chainSettings.oversampling);
+    
+    auto redesignAll = currentSampleRate != lastSampleRate;
+    auto responseChanged = designChain(lastCoefficients.main, lastSettings, chainSettings, currentSampleRate, redesignAll);
+    
+    const auto midSide = chainSettings.stereoMode == StereoMode::StereoMidSide;
+    
+    // The side chain went stale while it wasn't used, so it starts over.
+    if (midSide)
+    {
+        auto sideSettings = getChainSettings(apvts, "Side ");
+        
+        designChain(lastCoefficients.side,
+                    lastSideSettings,
+                    sideSettings,
+                    currentSampleRate,
+                    redesignAll || lastSettings.stereoMode != StereoMode::StereoMidSide);
+        
+        lastSideSettings = sideSettings;
+    }
+    
+    // The kernel is only kept up to date while linear phase is on. It is handed
+    // over before the settings below are, so the audio thread has it from the
+    // first block that runs in linear phase, offline renders included.
+    auto rebuildKernel = chainSettings.linearPhase
+                      && (responseChanged
+                          || !lastSettings.linearPhase
+                          || chainSettings.linearPhaseLength != lastSettings.linearPhaseLength);
+    
+    if (rebuildKernel)
+    {
+        // The kernel only knows a single response, the main one.
+        const auto& chainCoefficients = lastCoefficients.main;
+        
+        linearPhaseFilter.loadKernel([&chainCoefficients](double frequency)
+                                     {
+                                         return getChainMagnitudeForFrequency(chainCoefficients, frequency);
+                                     },
+                                     sampleRate.get(),
+                                     chainSettings.linearPhaseLength);
+    }
+    
+    lastSettings = chainSettings;
+    lastSampleRate = currentSampleRate;
+    
+    auto tailLength = getChainTailLengthSeconds(lastCoefficients.main);
+    
+    if (midSide)
+    {
+        tailLength = juce::jmax(tailLength, getChainTailLengthSeconds(lastCoefficients.side));
+    }
+    
+    tailLengthSeconds.set(tailLength);
+    
+    designedCoefficients.getWriteBuffer() = lastCoefficients;
+    designedCoefficients.publish();
+    
+    // Designs are keyed on the rate the filters run at, so the cache gets
+    // warmed for every oversampling factor as soon as it's in use.
+    if (currentSampleRate != lastPrewarmedSampleRate)
+    {
+        coefficientCache->prewarm(currentSampleRate);
+        lastPrewarmedSampleRate = currentSampleRate;
+    }
+}
+
+bool CoefficientPublisher::designChain(ChainCoefficients& coefficients,
+                                       const ChainSettings& previous,
+                                       const ChainSettings& settings,
+                                       double designSampleRate,
+                                       bool redesignAll)
+{
+    auto responseChanged = redesignAll;
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        if (redesignAll || bandSettingsDiffer(settings.bands[band], previous.bands[band]))
+        {
+            designBandCoefficients(coefficients, settings, band, designSampleRate, &coefficientCache.getObject());
+            ++numRedesigns;
+            responseChanged = true;
+        }
+        
+        responseChanged = responseChanged || settings.bands[band].bypassed != previous.bands[band].bypassed;
+    }
+    
+    if (redesignAll || lowCutSettingsDiffer(settings, previous))
+    {
+        designLowCutCoefficients(coefficients, settings, designSampleRate, &coefficientCache.getObject());
+        ++numRedesigns;
+        responseChanged = true;
+    }
+    
+    if (redesignAll || highCutSettingsDiffer(settings, previous))
+    {
+        designHighCutCoefficients(coefficients, settings, designSampleRate, &coefficientCache.getObject());
+        ++numRedesigns;
+        responseChanged = true;
+    }
+    
+    coefficients.settings = settings;
+    coefficients.sampleRate = designSampleRate;
+    
+    return responseChanged
+        || settings.lowCutBypassed != previous.lowCutBypassed
+        || settings.highCutBypassed != previous.highCutBypassed
+        || isDynamicBandActive(settings) != isDynamicBandActive(previous);
+}
+
+void CoefficientPublisher::publishIfChanged()
+{
+    if (parametersChanged.compareAndSetBool(false, true))
+    {
+        publish();
+    }
+    
+    updateRedesignRate();
+}
+
+void CoefficientPublisher::updateRedesignRate()
+{
+    const juce::ScopedLock sl(writeLock);
+    
+    auto now = juce::Time::getMillisecondCounterHiRes();
+    auto elapsed = now - rateWindowStart;
+    
+    if (elapsed < 1000.0)
+    {
+        return;
+    }
+    
+    auto total = numRedesigns.get();
+    
+    redesignsPerSecond.set(float((total - redesignsAtWindowStart) * 1000.0 / elapsed));
+    redesignsAtWindowStart = total;
+    rateWindowStart = now;
+}
+
+void CoefficientPublisher::parameterValueChanged(int parameterIndex, float newValue)
+{
+    // May be called from any thread, including the audio thread.
+    parametersChanged.set(true);
+}
+
+void SimpleEQAudioProcessor::addOriginalChainParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                                        const juce::String& prefix,
+                                                        int versionHint,
+                                                        bool automatable)
+{
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "LowCut Freq", versionHint },
+                                                                    prefix + "LowCut Freq",
+                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
+                                                                    20.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "HighCut Freq", versionHint },
+                                                                    prefix + "HighCut Freq",
+                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
+                                                                    20000.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    // Band 0 is the original peak band.
+    addBandParameters(parameterLayout, prefix, 0, versionHint, automatable);
+    
+    juce::StringArray filterSlopeOptions;
+    
+    for (int i = 0; i < Slope::NumOriginalSlopes; i++)
+    {
+        juce::String option;
+        option << getSlopeDecibelsPerOctave(static_cast<Slope>(i));
+        option << " dB/Oct";
+        filterSlopeOptions.add(option);
+    }
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "LowCut Slope", versionHint },
+                                                                     prefix + "LowCut Slope",
+                                                                     filterSlopeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "HighCut Slope", versionHint },
+                                                                     prefix + "HighCut Slope",
+                                                                     filterSlopeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + "LowCut Bypassed", versionHint },
+                                                                   prefix + "LowCut Bypassed",
+                                                                   false,
+                                                                   juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + "HighCut Bypassed", versionHint },
+                                                                   prefix + "HighCut Bypassed",
+                                                                   false,
+                                                                   juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + getBandParameterID(0, "Bypassed"), versionHint },
+                                                                   prefix + getBandParameterID(0, "Bypassed"),
+                                                                   false,
+                                                                   juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+}
+
+void SimpleEQAudioProcessor::addBandParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                               const juce::String& prefix,
+                                               int band,
+                                               int versionHint,
+                                               bool automatable)
+{
+    // Band 0 keeps the defaults of the original peak band, the others start
+    // out spread over the spectrum.
+    const auto defaultFreq = band == 0 ? 750.f
+                                       : (float) juce::roundToInt(30.0 * std::pow(500.0, (band - 1) / (MaxBands - 2.0)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + getBandParameterID(band, "Freq"), versionHint },
+                                                                    prefix + getBandParameterID(band, "Freq"),
+                                                                    juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.5f),
+                                                                    defaultFreq,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + getBandParameterID(band, "Gain"), versionHint },
+                                                                    prefix + getBandParameterID(band, "Gain"),
+                                                                    juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
+                                                                    0.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + getBandParameterID(band, "Quality"), versionHint },
+                                                                    prefix + getBandParameterID(band, "Quality"),
+                                                                    juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
+                                                                    1.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+}
+
+void SimpleEQAudioProcessor::addExtendedChainParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                                        const juce::String& prefix,
+                                                        int versionHint,
+                                                        bool automatable)
+{
+    const juce::StringArray bandTypeOptions { "Peak", "Low Shelf", "High Shelf", "Notch", "Band Pass", "Tilt" };
+    const juce::StringArray bandBackendOptions { "Biquad", "SVF" };
+    
+    jassert(bandTypeOptions.size() == NumBandTypes);
+    jassert(bandBackendOptions.size() == NumBandBackends);
+    
+    for (int band = 0; band < MaxBands; band++)
+    {
+        // Everything but the type and backend of band 0 is new.
+        if (band > 0)
+        {
+            addBandParameters(parameterLayout, prefix, band, versionHint, automatable);
+        }
+        
+        parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + getBandParameterID(band, "Type"), versionHint },
+                                                                         prefix + getBandParameterID(band, "Type"),
+                                                                         bandTypeOptions,
+                                                                         0,
+                                                                         juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+        
+        parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + getBandParameterID(band, "Backend"), versionHint },
+                                                                         prefix + getBandParameterID(band, "Backend"),
+                                                                         bandBackendOptions,
+                                                                         0,
+                                                                         juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+        
+        if (band > 0)
+        {
+            parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + getBandParameterID(band, "Bypassed"), versionHint },
+                                                                           prefix + getBandParameterID(band, "Bypassed"),
+                                                                           true,
+                                                                           juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+        }
+    }
+    
+    const juce::StringArray cutTypeOptions { "Butterworth", "Linkwitz-Riley" };
+    
+    juce::StringArray steepSlopeOptions { "Off" };
+    
+    for (int i = Slope::NumOriginalSlopes; i < Slope::NumSlopes; i++)
+    {
+        juce::String option;
+        option << getSlopeDecibelsPerOctave(static_cast<Slope>(i));
+        option << " dB/Oct";
+        steepSlopeOptions.add(option);
+    }
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "LowCut Type", versionHint },
+                                                                     prefix + "LowCut Type",
+                                                                     cutTypeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "HighCut Type", versionHint },
+                                                                     prefix + "HighCut Type",
+                                                                     cutTypeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "LowCut Steep Slope", versionHint },
+                                                                     prefix + "LowCut Steep Slope",
+                                                                     steepSlopeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { prefix + "HighCut Steep Slope", versionHint },
+                                                                     prefix + "HighCut Steep Slope",
+                                                                     steepSlopeOptions,
+                                                                     0,
+                                                                     juce::AudioParameterChoiceAttributes().withAutomatable(automatable)));
+    
+    // Band 0 as a dynamic band.
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + "Peak Dynamic", versionHint },
+                                                                   prefix + "Peak Dynamic",
+                                                                   false,
+                                                                   juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { prefix + "Peak Sidechain", versionHint },
+                                                                   prefix + "Peak Sidechain",
+                                                                   false,
+                                                                   juce::AudioParameterBoolAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "Peak Threshold", versionHint },
+                                                                    prefix + "Peak Threshold",
+                                                                    juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f),
+                                                                    -24.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "Peak Ratio", versionHint },
+                                                                    prefix + "Peak Ratio",
+                                                                    juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f),
+                                                                    4.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "Peak Attack", versionHint },
+                                                                    prefix + "Peak Attack",
+                                                                    juce::NormalisableRange<float>(0.1f, 100.f, 0.1f, 0.5f),
+                                                                    5.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { prefix + "Peak Release", versionHint },
+                                                                    prefix + "Peak Release",
+                                                                    juce::NormalisableRange<float>(5.f, 1000.f, 1.f, 0.5f),
+                                                                    100.f,
+                                                                    juce::AudioParameterFloatAttributes().withAutomatable(automatable)));
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout parameterLayout;
+    
+    // The parameters of the original release, in their original order.
+    addOriginalChainParameters(parameterLayout, {}, OriginalVersionHint, true);
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "Analyzer Enabled", OriginalVersionHint }, "Analyzer Enabled", true));
+    
+    // Everything added since, after them.
+    addExtendedChainParameters(parameterLayout, {}, ParametricVersionHint, true);
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "Smoothing", ParametricVersionHint }, "Smoothing", true));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "Oversampling", ParametricVersionHint },
+                                                                     "Oversampling",
+                                                                     juce::StringArray { "Off", "2x", "4x" },
+                                                                     0));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "Linear Phase", ParametricVersionHint }, "Linear Phase", false));
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "Linear Phase Length", ParametricVersionHint },
+                                                                     "Linear Phase Length",
+                                                                     juce::StringArray { "8192", "16384", "32768" },
+                                                                     1));
+    
+    // Has no effect while linear phase is on, which always runs left/right.
+    parameterLayout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { "Stereo Mode", ParametricVersionHint },
+                                                                     "Stereo Mode",
+                                                                     juce::StringArray { "Left/Right", "Mid/Side", "Mid Only", "Side Only" },
                                                                      0));
     
-    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "LowCut Bypassed", 1 }, "LowCut Bypassed", false));
-    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "HighCut Bypassed", 1 }, "HighCut Bypassed", false));
-    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "Peak Bypassed", 1 }, "Peak Bypassed", false));
-    parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "Analyzer Enabled", 1 }, "Analyzer Enabled", true));
+    // Every parameter of the chain again, for the side channel in mid/side
+    // mode. The editor has no controls for them yet, so they stay out of the
+    // way of host automation lanes until it does; they are still saved with
+    // the state and can be set through the APVTS.
+    addOriginalChainParameters(parameterLayout, "Side ", ParametricVersionHint, false);
+    addExtendedChainParameters(parameterLayout, "Side ", ParametricVersionHint, false);
     
     return parameterLayout;
 }
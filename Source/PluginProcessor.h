@@ -9,11 +9,15 @@
 #pragma once
 
 #include <JuceHeader.h>
-
-using Filter = juce::dsp::IIR::Filter<float>;
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
-using Coefficients = Filter::CoefficientsPtr;
+#include "BiquadCascade.h"
+#include "BiquadDesign.h"
+#include "CoefficientCache.h"
+#include "DynamicBand.h"
+#include "LinearPhaseFilter.h"
+#include "LoadMeter.h"
+#include "RealtimeChecker.h"
+#include "SVFCascade.h"
+#include "TripleBuffer.h"
 
 enum Channel
 {
@@ -21,24 +25,96 @@ enum Channel
     Left
 };
 
+// The "... Slope" parameters keep the four choices they always had, so that
+// saved and automated values keep their meaning. The steeper slopes come from
+// "... Steep Slope", which overrides them unless it is off.
 enum Slope
 {
     Slope_12,
     Slope_24,
     Slope_36,
-    Slope_48
+    Slope_48,
+    NumOriginalSlopes,
+    Slope_72 = NumOriginalSlopes,
+    Slope_96,
+    NumSlopes
+};
+
+constexpr int getSlopeDecibelsPerOctave(Slope slope)
+{
+    constexpr int decibelsPerOctave[] = { 12, 24, 36, 48, 72, 96 };
+    return decibelsPerOctave[slope];
+}
+
+// Every order adds 6 dB/oct.
+constexpr int getSlopeOrder(Slope slope) { return getSlopeDecibelsPerOctave(slope) / 6; }
+constexpr int getSlopeNumSections(Slope slope) { return getSlopeOrder(slope) / 2; }
+
+static_assert(getSlopeNumSections(Slope_96) == MaxCutSections, "");
+
+// Stored as the power of two of the factor.
+enum OversamplingFactor
+{
+    Oversampling_1x,
+    Oversampling_2x,
+    Oversampling_4x,
+    NumOversamplingFactors
 };
 
-enum ChainPositions
+// The rate the filters run at, and so the rate they get designed for.
+constexpr double getOversampledRate(double sampleRate, OversamplingFactor factor) { return sampleRate * (1 << factor); }
+
+// How the two channels of a stereo bus get filtered. Mid/side filters the sum
+// with the main settings and the difference with the "Side ..." ones, the
+// other two leave the channel they don't filter alone. Buses that aren't
+// stereo always run left/right, and so does linear phase mode, whose single
+// kernel only knows the main response.
+enum StereoMode
 {
-    LowCut,
-    Peak,
-    HighCut
+    StereoLeftRight,
+    StereoMidSide,
+    StereoMidOnly,
+    StereoSideOnly,
+    NumStereoModes
 };
 
+// Parametric bands, one second order section each. Band 0 is the peak band
+// this project started out with.
+constexpr int MaxBands = 24;
+
+// Band 0 keeps the "Peak ..." IDs it always had, the others are "Band 2 ..."
+// up to "Band 24 ...".
+juce::String getBandParameterID(int band, const juce::String& name);
+
+// Where the bands live inside a fused BiquadCascade.
+enum CascadeSections
+{
+    LowCutSection = 0,
+    BandSection = LowCutSection + MaxCutSections,
+    HighCutSection = BandSection + MaxBands,
+    NumCascadeSections = HighCutSection + MaxCutSections
+};
+
+// The buffers live on the heap and their number can be set at runtime, so a
+// FIFO only takes as much memory as its producer and consumer need.
 template<typename T>
 struct Fifo
 {
+    static constexpr int DefaultCapacity = 30;
+    
+    Fifo() { setCapacity(DefaultCapacity); }
+    
+    // Not realtime safe, and empties the FIFO. Holds capacity - 1 elements.
+    void setCapacity(int capacity)
+    {
+        jassert(capacity >= 2);
+        
+        buffers.resize((size_t) capacity);
+        fifo.setTotalSize(capacity);
+    }
+    
+    int getCapacity() const { return fifo.getTotalSize(); }
+    
     void prepare(int numChannels, int numSamples)
     {
         static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,
@@ -97,10 +173,29 @@ struct Fifo
     {
         return fifo.getNumReady();
     }
+    
+    // Only counts the sample data, for the buffer types prepare handles.
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = 0;
+        
+        for (const auto& buffer : buffers)
+        {
+            if constexpr (std::is_same_v<T, juce::AudioBuffer<float>>)
+            {
+                bytes += (size_t) buffer.getNumChannels() * (size_t) buffer.getNumSamples() * sizeof(float);
+            }
+            else if constexpr (std::is_same_v<T, std::vector<float>>)
+            {
+                bytes += buffer.capacity() * sizeof(float);
+            }
+        }
+        
+        return bytes;
+    }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo { Capacity };
+    std::vector<T> buffers;
+    juce::AbstractFifo fifo { DefaultCapacity };
 };
 
 template<typename BlockType>
@@ -111,21 +206,34 @@ struct SingleChannelSampleFifo
         prepared.set(false);
     }
     
-    void update(const BlockType& buffer)
+    // Takes float or double buffers, the analyzer itself always runs in float.
+    // Returns how many complete buffers were pushed to the FIFO.
+    template<typename SampleType>
+    int update(const juce::AudioBuffer<SampleType>& buffer)
     {
         jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channel);
+        jassert(buffer.getNumChannels() > 0);
         
-        auto* channelPtr = buffer.getReadPointer(channel);
+        // A mono bus feeds both sides of the analyzer.
+        auto* channelPtr = buffer.getReadPointer(juce::jmin((int) channel, buffer.getNumChannels() - 1));
+        
+        auto numPushed = 0;
         
         for (int i = 0; i < buffer.getNumSamples(); i++)
         {
-            pushSampleIntoFifo(channelPtr[i]);
+            if (pushSampleIntoFifo(static_cast<float>(channelPtr[i])))
+            {
+                numPushed++;
+            }
         }
+        
+        return numPushed;
     }
     
-    void prepare(int bufferSize)
+    void prepare(int bufferSize, int numBuffers = Fifo<BlockType>::DefaultCapacity)
     {
+        const juce::ScopedLock sl(consumerLock);
+        
         prepared.set(false);
         
         size.set(bufferSize);
@@ -136,6 +244,9 @@ struct SingleChannelSampleFifo
                              true,       // Clear extra space
                              true);      // Avoid reallocating
         
+        pulledBuffer.setSize(1, bufferSize, false, true, true);
+        
+        audioBufferFifo.setCapacity(numBuffers);
         audioBufferFifo.prepare(1, bufferSize);
         
         fifoIndex = 0;
@@ -143,22 +254,49 @@ struct SingleChannelSampleFifo
         prepared.set(true);
     }
     
+    // The consuming side may run on any one thread, prepare locks it out.
     int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
+    int getCapacity() const { return audioBufferFifo.getCapacity(); }
+    
+    size_t getMemoryUsage() const
+    {
+        return audioBufferFifo.getMemoryUsage()
+             + (size_t) (bufferToFill.getNumSamples() + pulledBuffer.getNumSamples()) * sizeof(float);
+    }
     
-    bool getAudioBuffer(BlockType& buffer) { return audioBufferFifo.pull(buffer); }
+    // Pulls the oldest complete buffer into one that prepare already sized,
+    // so the consumer never allocates, and hands it to readBuffer with
+    // prepare locked out. Returns false if there was none.
+    template<typename Callback>
+    bool readAudioBuffer(Callback&& readBuffer)
+    {
+        const juce::ScopedLock sl(consumerLock);
+        
+        if (!audioBufferFifo.pull(pulledBuffer))
+        {
+            return false;
+        }
+        
+        readBuffer(static_cast<const BlockType&>(pulledBuffer));
+        return true;
+    }
     
 private:
     Channel channel;
     int fifoIndex = 0;
     Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
+    BlockType bufferToFill, pulledBuffer;
     juce::Atomic<bool> prepared = false;
     juce::Atomic<int> size = 0;
+    juce::CriticalSection consumerLock;
     
-    void pushSampleIntoFifo(float sample)
+    // Returns true if a complete buffer was pushed first.
+    bool pushSampleIntoFifo(float sample)
     {
+        auto pushed = false;
+        
         if (fifoIndex == bufferToFill.getNumSamples())
         {
             auto ok = audioBufferFifo.push(bufferToFill);
@@ -166,74 +304,438 @@ private:
             juce::ignoreUnused(ok);
             
             fifoIndex = 0;
+            pushed = true;
         }
         
         bufferToFill.setSample(0, fifoIndex, sample);
         fifoIndex++;
+        
+        return pushed;
     }
 };
 
+// The FIFOs that carry audio from the processor to the analyzer of the editor.
+// The processor only allocates them while an editor is open.
+struct AnalyzerFifos
+{
+    using BlockType = juce::AudioBuffer<float>;
+    
+    // How often the analyzer thread drains the FIFOs, and how many of its
+    // frames they can hold before they start dropping audio.
+    static constexpr double ConsumerRateHz = 60.0;
+    static constexpr double FramesOfSlack = 4.0;
+    static constexpr int MinNumBuffers = 4;
+    
+    // Not realtime safe. Holds enough host blocks to cover FramesOfSlack
+    // frames of the editor at this rate, but no more than fits into
+    // memoryBudget bytes (if it isn't 0), and never fewer than MinNumBuffers.
+    void prepare(int blockSize, double sampleRate, size_t memoryBudget);
+    
+    bool isPrepared() const { return left.isPrepared() && right.isPrepared(); }
+    size_t getMemoryUsage() const { return left.getMemoryUsage() + right.getMemoryUsage(); }
+    
+    // True if the budget was too small for even MinNumBuffers blocks, and got
+    // exceeded because of it.
+    bool isOverBudget() const { return overBudget; }
+    
+    SingleChannelSampleFifo<BlockType> left { Channel::Left }, right { Channel::Right };
+    
+private:
+    bool overBudget { false };
+};
+
+// Bytes held per subsystem. Buffers that JUCE allocates (oversampling,
+// convolution) are estimated from their sizes.
+struct MemoryUsage
+{
+    size_t filters { 0 };      // The filter engines and oversamplers.
+    size_t linearPhase { 0 };
+    size_t analyzer { 0 };     // Zero while no editor is open.
+    size_t shared { 0 };       // Held once per process, not per instance.
+    
+    // Set while the analyzer takes more than its budget allows, see
+    // SimpleEQAudioProcessor::setAnalyzerMemoryBudget.
+    bool analyzerOverBudget { false };
+    
+    size_t getInstanceTotal() const { return filters + linearPhase + analyzer; }
+};
+
+// How a band is run. Biquads are the cheapest to run, state variable filters
+// are the ones to use for bands that get modulated a lot.
+enum BandBackend
+{
+    BiquadBackend,
+    SVFBackend,
+    NumBandBackends
+};
+
+struct BandSettings
+{
+    BandType type { BandType::PeakBand };
+    BandBackend backend { BandBackend::BiquadBackend };
+    float freq { 0.f }, gainDecibels { 0.f }, quality { 1.f };
+    bool bypassed { false };
+};
+
 struct ChainSettings
 {
-    float peakFreq { 0.f }, peakGainDecibels { 0.f }, peakQuality { 1.f };
+    std::array<BandSettings, MaxBands> bands;
+    DynamicSettings dynamics; // Of band 0.
     float lowCutFreq { 0.f }, highCutFreq { 0.f };
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
-    bool lowCutBypassed { false }, highCutBypassed { false }, peakBypassed { false };
+    CutType lowCutType { CutType::Butterworth }, highCutType { CutType::Butterworth };
+    bool lowCutBypassed { false }, highCutBypassed { false };
+    OversamplingFactor oversampling { OversamplingFactor::Oversampling_1x };
+    bool linearPhase { false };
+    int linearPhaseLength { 16384 };
+    StereoMode stereoMode { StereoMode::StereoLeftRight };
+};
+
+// Everything processBlock needs to configure its filters, designed up front
+// so that the audio thread only has to copy numbers around.
+struct ChainCoefficients
+{
+    std::array<BiquadCoefficients, MaxBands> bands;
+    std::array<BiquadCoefficients, MaxCutSections> lowCut, highCut;
+    
+    // Only designed for the bands that use the SVF backend.
+    std::array<SVFCoefficients, MaxBands> svfBands;
+    
+    // Band 0 as a dynamic band, redesigned together with it.
+    BiquadCoefficients dynamicBandPass;
+    
+    // The settings these coefficients were designed from, and the rate they
+    // were designed for (the oversampled one if oversampling is on).
+    ChainSettings settings;
+    double sampleRate { 0.0 };
+    
+    // Bumped whenever the coefficients of a band are redesigned, so that the
+    // audio thread can skip copying bands that haven't changed.
+    std::array<int, MaxBands> bandVersions {};
+    int lowCutVersion { 0 }, highCutVersion { 0 };
 };
 
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+// What gets published to the audio thread. The side chain is only designed
+// (and only kept up to date) in mid/side mode.
+struct StereoChainCoefficients
+{
+    ChainCoefficients main, side;
+};
+
+// The prefix selects the chain, "Side " for the side one. Oversampling,
+// linear phase and the stereo mode are shared and never prefixed.
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts, const juce::String& prefix = {});
+
+// Bypass flags are deliberately ignored, toggling a band never needs a redesign.
+bool bandSettingsDiffer(const BandSettings& a, const BandSettings& b);
+bool lowCutSettingsDiffer(const ChainSettings& a, const ChainSettings& b);
+bool highCutSettingsDiffer(const ChainSettings& a, const ChainSettings& b);
+
+// Designs through the cache if one is given.
+void designBandCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, int band, double sampleRate,
+                            CoefficientCache* cache = nullptr);
+void designLowCutCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate,
+                              CoefficientCache* cache = nullptr);
+void designHighCutCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate,
+                               CoefficientCache* cache = nullptr);
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate, CoefficientCache* cache = nullptr);
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
+// Combined magnitude of every active section, as the response curve shows it.
+double getChainMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, double frequency);
 
-template<int Index, typename ChainType, typename CoefficientType>
-void updateCutCoefficients(ChainType& chain, const CoefficientType& coefficients)
+// How long the active sections ring after the input stops.
+double getChainTailLengthSeconds(const ChainCoefficients& chainCoefficients);
+
+// A band at 0 dB that only changes the gain doesn't do anything and can be left out.
+inline bool isBandNeutral(const BandSettings& bandSettings)
 {
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
+    return bandTypeUsesGain(bandSettings.type) && bandSettings.gainDecibels == 0.f;
 }
 
-template<typename ChainType, typename CoefficientType>
-void updateCutCoefficients(ChainType& chain, const CoefficientType& coefficients, const Slope& slope)
+// Only band 0 can be dynamic, and only as a peak band.
+inline bool isDynamicBandActive(const ChainSettings& chainSettings)
 {
-    chain.template setBypassed<0>(true);
-    chain.template setBypassed<1>(true);
-    chain.template setBypassed<2>(true);
-    chain.template setBypassed<3>(true);
-    
-    switch (slope)
-    {
-        case Slope_48:
-            updateCutCoefficients<3>(chain, coefficients);
-        case Slope_36:
-            updateCutCoefficients<2>(chain, coefficients);
-        case Slope_24:
-            updateCutCoefficients<1>(chain, coefficients);
-        case Slope_12:
-            updateCutCoefficients<0>(chain, coefficients);
-            break;
-    }
+    const auto& band = chainSettings.bands[0];
+    return chainSettings.dynamics.enabled && !band.bypassed && band.type == BandType::PeakBand;
 }
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+// Whether a band contributes to the static response at all.
+inline bool isBandAudible(const BandSettings& bandSettings)
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       (chainSettings.lowCutSlope + 1) * 2);
+    return !bandSettings.bypassed && !isBandNeutral(bandSettings);
 }
 
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+//==============================================================================
+
+struct CoefficientPublisher;
+
+// One low priority thread per process that redesigns filters for every
+// instance whose parameters have changed since the last poll.
+//
+// The lock only guards the list of publishers, the designs themselves run
+// without it, so one instance building a long linear phase kernel neither
+// holds up the others nor instances getting created or deleted. Removing the
+// publisher that is being designed for waits until that design is done.
+struct CoefficientDesignThread : juce::Thread
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      (chainSettings.highCutSlope + 1) * 2);
-}
+    CoefficientDesignThread();
+    ~CoefficientDesignThread() override;
+    
+    void addPublisher(CoefficientPublisher* publisher);
+    void removePublisher(CoefficientPublisher* publisher);
+    
+    void run() override;
+
+private:
+    static constexpr int PollIntervalMs = 5;
+    
+    juce::CriticalSection lock;
+    juce::Array<CoefficientPublisher*> publishers;
+    
+    // Guarded by lock.
+    CoefficientPublisher* activePublisher { nullptr };
+    juce::WaitableEvent activePublisherDone;
+    
+    // Design thread only, a copy of publishers to work through.
+    juce::Array<CoefficientPublisher*> pendingPublishers;
+};
+
+// Watches the parameters of a processor, designs a complete set of
+// coefficients off the audio thread and hands it over through a TripleBuffer. Only the
+// bands whose settings actually changed since the last publish are redesigned.
+// In linear phase mode it also rebuilds the kernel of the LinearPhaseFilter.
+struct CoefficientPublisher : juce::AudioProcessorParameter::Listener
+{
+    CoefficientPublisher(juce::AudioProcessor& processor,
+                         juce::AudioProcessorValueTreeState& apvts,
+                         LinearPhaseFilter& linearPhaseFilter);
+    ~CoefficientPublisher() override;
+    
+    // Not realtime safe: designs with the new sample rate before returning.
+    void prepare(double sampleRate);
+    
+    void publish();
+    void publishIfChanged();
+    void markChanged() { parametersChanged.set(true); }
+    
+    // Audio thread only.
+    bool pull() { return designedCoefficients.pull(); }
+    const StereoChainCoefficients& getCoefficients() const { return designedCoefficients.getReadBuffer(); }
+    
+    // Number of band redesigns, in total and over the last second.
+    int getNumRedesigns() const { return numRedesigns.get(); }
+    float getRedesignsPerSecond() const { return redesignsPerSecond.get(); }
+    
+    double getTailLengthSeconds() const { return tailLengthSeconds.get(); }
+    
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override { }
+
+private:
+    juce::AudioProcessor& processor;
+    juce::AudioProcessorValueTreeState& apvts;
+    LinearPhaseFilter& linearPhaseFilter;
+    
+    juce::Atomic<bool> parametersChanged { false };
+    juce::Atomic<double> sampleRate { 0.0 };
+    
+    juce::CriticalSection writeLock;
+    TripleBuffer<StereoChainCoefficients> designedCoefficients;
+    
+    // Guarded by writeLock.
+    ChainSettings lastSettings, lastSideSettings;
+    StereoChainCoefficients lastCoefficients;
+    double lastSampleRate { 0.0 };
+    double lastPrewarmedSampleRate { 0.0 };
+    double rateWindowStart { 0.0 };
+    int redesignsAtWindowStart { 0 };
+    
+    juce::Atomic<int> numRedesigns { 0 };
+    juce::Atomic<float> redesignsPerSecond { 0.f };
+    
+    juce::Atomic<double> tailLengthSeconds { 0.0 };
+    
+    void updateRedesignRate();
+    
+    // Redesigns whatever differs from previous, returns true if the response changed.
+    bool designChain(ChainCoefficients& coefficients, const ChainSettings& previous, const ChainSettings& settings,
+                     double designSampleRate, bool redesignAll);
+    
+    juce::SharedResourcePointer<CoefficientDesignThread> designThread;
+    juce::SharedResourcePointer<CoefficientCache> coefficientCache;
+};
+
+//==============================================================================
+
+// Interleaves the channels, SIMDSample::size() at a time, into the lanes of a
+// SIMD register and runs one fused BiquadCascade per group of lanes. The pool
+// of groups is sized to the channel count in prepare, and all of them share
+// the same coefficients, so a 7.1.4 bus costs one design per change just like
+// a stereo one.
+//
+// With smoothing enabled, frequency, gain and quality ramp towards the newly
+// published settings and the moving bands get redesigned on a fixed grid of
+// smoothing interval samples, independent of the host block size. Once the
+// ramps have settled the exact published coefficients take over and nothing
+// gets redesigned anymore.
+//
+// The engine runs at whatever rate the coefficients were designed for, so a
+// new oversampling factor takes effect together with the matching designs.
+//
+// Bands on the SVF backend leave the biquad cascade for an SVFCascade per
+// group, which runs after it. While they ramp, their coefficients move every
+// sample rather than once per smoothing interval.
+//
+// When band 0 is dynamic it leaves the cascade, and a DynamicBand per group
+// of lanes runs after it. Its detector listens to the band's own input or to
+// the sidechain, whose channels map onto the lanes the same way as the main
+// ones do (a narrower sidechain repeats its last channel).
+//
+// FloatType is float or double. Coefficients are designed in double either way.
+template<typename FloatType>
+struct SIMDFilterEngine
+{
+    using SIMDSample = juce::dsp::SIMDRegister<FloatType>;
+    
+    // Not realtime safe. The block size has to allow for the largest
+    // oversampling factor.
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    void setCoefficients(const ChainCoefficients& chainCoefficients);
+    void setSmoothing(bool shouldSmooth, int intervalInSamples);
+    
+    // The sidechain may be empty, and may run at a fraction of the rate of
+    // block, in which case every sample is held (the engine runs oversampled,
+    // the sidechain never is).
+    void process(const juce::dsp::AudioBlock<FloatType>& block, const juce::dsp::AudioBlock<FloatType>& sidechain);
+    
+    bool isSmoothing() const { return numRampingBands > 0 || lowCutRamping || highCutRamping; }
+    
+    // True when silent input would only produce silence below threshold.
+    bool hasDecayed(FloatType threshold) const;
+    
+    static constexpr size_t getNumLanes() { return SIMDSample::size(); }
+    
+    size_t getMemoryUsage() const;
+    
+private:
+    // One cascade per group of channels. Every cascade gets the same
+    // coefficients, only the filter states differ.
+    std::vector<BiquadCascade<SIMDSample, NumCascadeSections>> cascades;
+    std::vector<SVFCascade<SIMDSample, MaxBands>> svfCascades;
+    size_t numChannels { 0 };
+
+    juce::HeapBlock<char> interleavedData;
+    juce::dsp::AudioBlock<SIMDSample> interleaved;
+    
+    std::vector<DynamicBand<SIMDSample>> dynamicBands;
+    juce::HeapBlock<char> interleavedSidechainData;
+    juce::dsp::AudioBlock<SIMDSample> interleavedSidechain;
+    bool dynamicActive { false }, sidechainActive { false };
+    
+    std::array<int, MaxBands> appliedBandVersions {};
+    std::array<BandType, MaxBands> appliedBandTypes {};
+    std::array<BandBackend, MaxBands> appliedBandBackends {};
+    int appliedLowCutVersion { -1 }, appliedHighCutVersion { -1 };
+    Slope appliedLowCutSlope { Slope::Slope_12 }, appliedHighCutSlope { Slope::Slope_12 };
+    CutType appliedLowCutType { CutType::Butterworth }, appliedHighCutType { CutType::Butterworth };
+    
+    ChainCoefficients target;
+    double sampleRate { 44100.0 };
+    
+    static constexpr double SmoothingTimeSeconds = 0.05;
+    
+    bool smoothingEnabled { true };
+    int smoothingInterval { 32 };
+    int samplesUntilUpdate { 0 };
+    
+    using MultiplicativeValue = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative>;
+    using LinearValue = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>;
+    
+    std::array<MultiplicativeValue, MaxBands> bandFreqs, bandQualities;
+    std::array<LinearValue, MaxBands> bandGains;
+    std::array<bool, MaxBands> bandRamping {};
+    int numRampingBands { 0 };
+    
+    MultiplicativeValue lowCutFreq, highCutFreq;
+    bool lowCutRamping { false }, highCutRamping { false };
+    
+    void updateCutSections(int firstSection, const std::array<BiquadCoefficients, MaxCutSections>& coefficients,
+                           Slope slope, bool bypassed, bool coefficientsChanged);
+    void updateBandFilter(const ChainCoefficients& chainCoefficients, int band);
+    void updateLowCutFilter(const ChainCoefficients& chainCoefficients);
+    void updateHighCutFilter(const ChainCoefficients& chainCoefficients);
+    void updateSmoothedFilters();
+    void setBandRamping(int band, bool shouldRamp);
+    void updateDynamicBand();
+    void setDynamicBandPass(const BiquadCoefficients& bandPass, float staticGainDecibels);
+    void interleaveSidechain(const juce::dsp::AudioBlock<FloatType>& sidechain, size_t numSamples);
+    void updateBandActive(int band);
+    void setSampleRate(double newSampleRate);
+    
+    void processGroups(size_t startSample, size_t numSamples);
+    void setSectionCoefficients(int section, const BiquadCoefficients& coefficients);
+    void setSectionActive(int section, bool shouldBeActive);
+    void setSVFCoefficients(int band, const SVFCoefficients& coefficients, int numSteps);
+    void setSVFActive(int band, bool shouldBeActive);
+};
+
+// The filter engine together with the oversamplers around it. In the stereo
+// modes other than left/right, a stereo block gets encoded to mid/side in
+// place before it is upsampled and decoded in place once it is back, and each
+// engine runs on just the channel it filters.
+template<typename FloatType>
+struct FilterStage
+{
+    // Not realtime safe. Every oversampling factor is allocated here so that
+    // switching between them never allocates.
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    void setCoefficients(const StereoChainCoefficients& stereoCoefficients);
+    
+    void setSmoothing(bool shouldSmooth, int intervalInSamples)
+    {
+        engine.setSmoothing(shouldSmooth, intervalInSamples);
+        sideEngine.setSmoothing(shouldSmooth, intervalInSamples);
+    }
+    
+    // Returns false if the block was skipped, which happens for silent input
+    // once the filters have rung out. The sidechain may be empty.
+    bool process(juce::dsp::AudioBlock<FloatType>& block, const juce::dsp::AudioBlock<FloatType>& sidechain, bool inputIsSilent);
+    
+    int getLatencyInSamples(OversamplingFactor factor) const;
+    
+    // Zero until prepared.
+    size_t getMemoryUsage() const;
+    
+private:
+    // The side engine only ever runs the side channel in mid/side mode.
+    SIMDFilterEngine<FloatType> engine, sideEngine;
+    StereoMode stereoMode { StereoMode::StereoLeftRight };
+    
+    // Index 0 (no oversampling) stays empty.
+    std::array<std::unique_ptr<juce::dsp::Oversampling<FloatType>>, NumOversamplingFactors> oversamplers;
+    OversamplingFactor activeOversampling { OversamplingFactor::Oversampling_1x };
+    bool skippingSilence { false };
+    juce::dsp::ProcessSpec preparedSpec { 0.0, 0, 0 };
+    
+    bool isSmoothing() const;
+    bool hasDecayed() const;
+    void processEngines(const juce::dsp::AudioBlock<FloatType>& block, const juce::dsp::AudioBlock<FloatType>& sidechain);
+    
+    // In place, in one pass each.
+    static void encodeMidSide(juce::dsp::AudioBlock<FloatType>& block);
+    static void decodeMidSide(juce::dsp::AudioBlock<FloatType>& block);
+};
 
 //==============================================================================
 /**
 */
-class SimpleEQAudioProcessor  : public juce::AudioProcessor
+class SimpleEQAudioProcessor  : public juce::AudioProcessor,
+                                private juce::Timer
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -252,6 +754,9 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -276,21 +781,124 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
+    // Up to 7.1.4.
+    static constexpr int MaxNumChannels = 12;
+    
+    // How often (in samples) ramping bands get redesigned while smoothing.
+    void setSmoothingInterval(int numSamples) { smoothingInterval.set(juce::jmax(1, numSamples)); }
+    int getSmoothingInterval() const { return smoothingInterval.get(); }
+    
+    int getNumRedesigns() const { return coefficientPublisher.getNumRedesigns(); }
+    float getRedesignsPerSecond() const { return coefficientPublisher.getRedesignsPerSecond(); }
+    
+    // Blocks that ran through the filters, and blocks skipped because the
+    // input was silent and the filters had rung out.
+    int getNumProcessedBlocks() const { return numProcessedBlocks.get(); }
+    int getNumSkippedBlocks() const { return numSkippedBlocks.get(); }
+    
+    // How much of each block's realtime budget processBlock takes.
+    LoadMeter::Statistics getLoadStatistics() const { return loadMeter.getStatistics(); }
+    void resetLoadStatistics() { loadMeter.reset(); }
+    void setOverrunThreshold(float fractionOfBudget) { loadMeter.setOverrunThreshold(fractionOfBudget); }
+    
+    // Below this (-120 dB) input counts as silence, and filters as rung out.
+    static constexpr double SilenceThreshold = 1.0e-6;
+    
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    // Hosts that address parameters by index (AU, VST2) see every parameter in
+    // the order it's added, so the ones of the original three band EQ come
+    // first, unchanged, and everything added since follows with a higher
+    // version hint. Between them, the two add everything getChainSettings reads
+    // with a prefix.
+    static constexpr int OriginalVersionHint = 1;
+    static constexpr int ParametricVersionHint = 2;
+    
+    static void addOriginalChainParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                           const juce::String& prefix,
+                                           int versionHint,
+                                           bool automatable);
+    static void addExtendedChainParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                           const juce::String& prefix,
+                                           int versionHint,
+                                           bool automatable);
+    
+    // Freq, Gain and Quality of one band.
+    static void addBandParameters(juce::AudioProcessorValueTreeState::ParameterLayout& parameterLayout,
+                                  const juce::String& prefix,
+                                  int band,
+                                  int versionHint,
+                                  bool automatable);
     juce::AudioProcessorValueTreeState apvts { *this, nullptr, "Parameters", createParameterLayout() };
 
-    using BlockType = juce::AudioBuffer<float>;
+    using BlockType = AnalyzerFifos::BlockType;
+    
+    // Message thread only. The analyzer FIFOs get allocated by the first
+    // editor that attaches and freed once the last one has detached, so an
+    // instance without an open editor doesn't pay for them. The reference
+    // stays valid until then.
+    AnalyzerFifos& attachAnalyzer();
+    void detachAnalyzer();
     
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    // Message thread only. Limits the analyzer FIFOs to this many bytes, 0
+    // leaves them sized by the consumption rate alone. They never hold fewer
+    // than AnalyzerFifos::MinNumBuffers host blocks, so a budget below
+    // (MinNumBuffers + 1) blocks of both channels gets exceeded. Returns false
+    // if that already happened to the open editor's FIFOs; getMemoryUsage()
+    // flags it for as long as it lasts, including for editors opened later.
+    bool setAnalyzerMemoryBudget(size_t bytes);
+    
+    MemoryUsage getMemoryUsage() const;
     
 private:
-    MonoChain leftChain, rightChain;
+    // Only the one matching the processing precision gets prepared.
+    FilterStage<float> floatFilters;
+    FilterStage<double> doubleFilters;
+    
+    LinearPhaseFilter linearPhaseFilter;
+    bool linearPhaseActive { false };
+    
+    CoefficientPublisher coefficientPublisher { *this, apvts, linearPhaseFilter };
+    
+    std::atomic<float>* smoothingEnabled { apvts.getRawParameterValue("Smoothing") };
+    juce::Atomic<int> smoothingInterval { 32 };
+    
+    juce::Atomic<int> numProcessedBlocks { 0 }, numSkippedBlocks { 0 };
+    
+    LoadMeter loadMeter;
+    
+    // Swapped in and out under the lock, which the audio thread only ever
+    // tries to take. A block that finds it taken just isn't analysed.
+    std::unique_ptr<AnalyzerFifos> analyzerFifos;
+    juce::SpinLock analyzerLock;
+    int numAnalyzerUsers { 0 };
+    size_t analyzerMemoryBudget { 0 };
+    int preparedBlockSize { 0 };
+    double preparedSampleRate { 0.0 };
+    
+    void prepareAnalyzer();
+    
+    // Latency of each oversampling factor, filled in prepareToPlay.
+    std::array<int, NumOversamplingFactors> oversamplingLatencies {};
+    
+    // The latency of whatever the audio thread switched to last. The audio
+    // thread only stores it, a message thread timer tells the host once the
+    // switch has actually happened.
+    static constexpr int LatencyPollRateHz = 10;
+    juce::Atomic<int> activeLatency { -1 };
+    void timerCallback() override;
+    
+    // Returns true if new coefficients were picked up.
+    bool updateFilters();
+    
+    template<typename FloatType>
+    void prepareFilters(FilterStage<FloatType>& filters, const juce::dsp::ProcessSpec& spec);
+    
+    template<typename FloatType>
+    void process(juce::AudioBuffer<FloatType>& buffer, FilterStage<FloatType>& filters);
     
-    void updatePeakFilter(const ChainSettings& chainSettings);
-    void updateLowCutFilter(const ChainSettings& chainSettings);
-    void updateHighCutFilter(const ChainSettings& chainSettings);
-    void updateFilters();
+    template<typename FloatType>
+    static bool isSilent(const juce::dsp::AudioBlock<FloatType>& block);
     
     juce::dsp::Oscillator<float> osc;
     
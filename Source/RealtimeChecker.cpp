@@ -0,0 +1,316 @@
+/*
+  ==============================================================================
+
+    RealtimeChecker.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeChecker.h"
+
+#if SIMPLEEQ_ENABLE_REALTIME_CHECKS
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+ #include <malloc.h>
+#else
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+#endif
+
+namespace RealtimeChecker
+{
+    namespace
+    {
+        thread_local bool isRealtimeThread = false;
+        
+        // Set while a violation is being recorded, so that whatever capturing
+        // the stack does isn't recorded as well.
+        thread_local bool isRecording = false;
+        
+        struct RecordedViolation
+        {
+            Violation violation;
+            std::atomic<bool> isReady { false };
+        };
+        
+        std::atomic<int> violationCounts[NumViolationTypes] {};
+        std::atomic<int> numClaimedViolations { 0 };
+        RecordedViolation recordedViolations[MaxRecordedViolations];
+        
+        int captureStack(void** frames, int maxFrames)
+        {
+           #if JUCE_WINDOWS
+            return (int) CaptureStackBackTrace(0, (DWORD) maxFrames, frames, nullptr);
+           #else
+            return backtrace(frames, maxFrames);
+           #endif
+        }
+        
+        // Called from inside the allocator, so this must neither allocate nor
+        // lock. Every slot is claimed by exactly one thread and written once.
+        void record(ViolationType type, size_t size)
+        {
+            if (!isRealtimeThread || isRecording)
+            {
+                return;
+            }
+            
+            isRecording = true;
+            
+            ++violationCounts[type];
+            
+            auto index = numClaimedViolations++;
+            
+            if (index < MaxRecordedViolations)
+            {
+                auto& slot = recordedViolations[index];
+                slot.violation.type = type;
+                slot.violation.size = size;
+                slot.violation.numStackFrames = captureStack(slot.violation.stack, Violation::MaxStackFrames);
+                slot.isReady.store(true, std::memory_order_release);
+            }
+            
+            isRecording = false;
+        }
+    }
+    
+    ScopedRealtimeSection::ScopedRealtimeSection(bool isRealtime) :
+    wasRealtime(isRealtimeThread)
+    {
+        isRealtimeThread = wasRealtime || isRealtime;
+    }
+    
+    ScopedRealtimeSection::~ScopedRealtimeSection()
+    {
+        isRealtimeThread = wasRealtime;
+    }
+    
+    int getNumViolations(ViolationType type)
+    {
+        return violationCounts[type].load();
+    }
+    
+    int getNumViolations()
+    {
+        auto total = 0;
+        
+        for (auto& count : violationCounts)
+        {
+            total += count.load();
+        }
+        
+        return total;
+    }
+    
+    bool getViolation(int index, Violation& violation)
+    {
+        auto numRecorded = juce::jmin(numClaimedViolations.load(), MaxRecordedViolations);
+        
+        if (!juce::isPositiveAndBelow(index, numRecorded)
+            || !recordedViolations[index].isReady.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        
+        violation = recordedViolations[index].violation;
+        return true;
+    }
+    
+    juce::String describe(const Violation& violation)
+    {
+        static const char* const typeNames[] = { "Allocation", "Deallocation", "Lock" };
+        
+        juce::String description(typeNames[violation.type]);
+        
+        if (violation.type == Allocation)
+        {
+            description << " of " << (int) violation.size << " bytes";
+        }
+        
+        description << " on the audio thread" << juce::newLine;
+       
+       #if JUCE_WINDOWS
+        for (int i = 0; i < violation.numStackFrames; i++)
+        {
+            description << "  " << juce::String::toHexString((juce::pointer_sized_int) violation.stack[i]) << juce::newLine;
+        }
+       #else
+        if (auto* symbols = backtrace_symbols(violation.stack, violation.numStackFrames))
+        {
+            for (int i = 0; i < violation.numStackFrames; i++)
+            {
+                description << "  " << symbols[i] << juce::newLine;
+            }
+            
+            std::free(symbols);
+        }
+       #endif
+        
+        return description;
+    }
+    
+    void reset()
+    {
+        for (auto& count : violationCounts)
+        {
+            count = 0;
+        }
+        
+        for (auto& slot : recordedViolations)
+        {
+            slot.isReady = false;
+        }
+        
+        numClaimedViolations = 0;
+    }
+}
+
+//==============================================================================
+// Replacements for the global allocation functions. They only differ from the
+// defaults in reporting what happens on a realtime thread.
+
+static void* allocate(size_t size)
+{
+    RealtimeChecker::record(RealtimeChecker::Allocation, size);
+    
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* allocateAligned(size_t size, std::align_val_t alignment)
+{
+    RealtimeChecker::record(RealtimeChecker::Allocation, size);
+   
+   #if JUCE_WINDOWS
+    return _aligned_malloc(size == 0 ? 1 : size, (size_t) alignment);
+   #else
+    void* memory = nullptr;
+    return posix_memalign(&memory, juce::jmax((size_t) alignment, sizeof(void*)), size == 0 ? 1 : size) == 0 ? memory
+                                                                                                          : nullptr;
+   #endif
+}
+
+static void deallocate(void* memory)
+{
+    if (memory != nullptr)
+    {
+        RealtimeChecker::record(RealtimeChecker::Deallocation, 0);
+        std::free(memory);
+    }
+}
+
+static void deallocateAligned(void* memory)
+{
+    if (memory != nullptr)
+    {
+        RealtimeChecker::record(RealtimeChecker::Deallocation, 0);
+       
+       #if JUCE_WINDOWS
+        _aligned_free(memory);
+       #else
+        std::free(memory);
+       #endif
+    }
+}
+
+void* operator new(size_t size)
+{
+    if (auto* memory = allocate(size))
+    {
+        return memory;
+    }
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (auto* memory = allocateAligned(size, alignment))
+    {
+        return memory;
+    }
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept                                          { deallocate(memory); }
+void operator delete[](void* memory) noexcept                                        { deallocate(memory); }
+void operator delete(void* memory, size_t) noexcept                                  { deallocate(memory); }
+void operator delete[](void* memory, size_t) noexcept                                { deallocate(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept                   { deallocate(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept                 { deallocate(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept                        { deallocateAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept                      { deallocateAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept                { deallocateAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept              { deallocateAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept   { deallocateAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned(memory); }
+
+//==============================================================================
+// juce::CriticalSection, juce::WaitableEvent and std::mutex all end up here on
+// Linux and macOS. Only calls made from the binary this is linked into are
+// seen, which covers our code and the JUCE modules, but not the host.
+#if !JUCE_WINDOWS
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    using LockFunction = int (*)(pthread_mutex_t*);
+    
+    // Constant initialised, so unlike a dynamically initialised static it
+    // needs no guard, which would lock.
+    static std::atomic<LockFunction> realLock { nullptr };
+    
+    auto lock = realLock.load(std::memory_order_relaxed);
+    
+    if (lock == nullptr)
+    {
+        lock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        realLock.store(lock, std::memory_order_relaxed);
+    }
+    
+    RealtimeChecker::record(RealtimeChecker::Lock, 0);
+    
+    return lock(mutex);
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    RealtimeChecker.h
+    Opt-in detection of heap allocations and mutex locks on the audio thread.
+    Build with SIMPLEEQ_ENABLE_REALTIME_CHECKS=1 to replace the global
+    operator new/delete and hook pthread_mutex_lock. Everything that happens
+    inside a RealtimeChecker::ScopedRealtimeSection is then recorded together
+    with a stack trace. Without the flag all of this compiles to nothing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef SIMPLEEQ_ENABLE_REALTIME_CHECKS
+ #define SIMPLEEQ_ENABLE_REALTIME_CHECKS 0
+#endif
+
+namespace RealtimeChecker
+{
+    enum ViolationType
+    {
+        Allocation,
+        Deallocation,
+        Lock,
+        NumViolationTypes
+    };
+    
+    struct Violation
+    {
+        static constexpr int MaxStackFrames = 32;
+        
+        ViolationType type { Allocation };
+        size_t size { 0 }; // Bytes, for allocations.
+        void* stack[MaxStackFrames] {};
+        int numStackFrames { 0 };
+    };
+    
+    // Only the first MaxRecordedViolations keep their stacks, the rest are
+    // just counted.
+    constexpr int MaxRecordedViolations = 256;
+   
+   #if SIMPLEEQ_ENABLE_REALTIME_CHECKS
+    // Marks the current thread as realtime for as long as it exists. Sections
+    // can nest.
+    struct ScopedRealtimeSection
+    {
+        explicit ScopedRealtimeSection(bool isRealtime = true);
+        ~ScopedRealtimeSection();
+    
+    private:
+        bool wasRealtime;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+    
+    constexpr bool isEnabled() { return true; }
+    
+    int getNumViolations(ViolationType type);
+    int getNumViolations();
+    
+    // Returns false if index isn't a recorded violation.
+    bool getViolation(int index, Violation& violation);
+    
+    // Allocates, so call it from anywhere but the audio thread.
+    juce::String describe(const Violation& violation);
+    
+    // Not safe while anything is processing.
+    void reset();
+   #else
+    struct ScopedRealtimeSection
+    {
+        explicit ScopedRealtimeSection(bool = true) {}
+    };
+    
+    constexpr bool isEnabled() { return false; }
+    
+    inline int getNumViolations(ViolationType) { return 0; }
+    inline int getNumViolations() { return 0; }
+    inline bool getViolation(int, Violation&) { return false; }
+    inline juce::String describe(const Violation&) { return {}; }
+    inline void reset() {}
+   #endif
+}
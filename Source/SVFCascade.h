@@ -0,0 +1,316 @@
+/*
+  ==============================================================================
+
+    SVFCascade.h
+    Topology preserving (trapezoidal) state variable filters, an alternative
+    to the biquads for bands that get modulated a lot.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BiquadDesign.h"
+
+// One band as a state variable filter: the cutoff (g = tan(pi f / fs)), the
+// damping (k = 1 / Q), and how much of the input, band pass and low pass
+// outputs get mixed into the result. Only g needs a tan, everything else is
+// arithmetic, and the filter stays stable for any positive g and k no matter
+// how fast they change.
+struct SVFCoefficients
+{
+    double g { 0.0 }, k { 1.0 }, m0 { 1.0 }, m1 { 0.0 }, m2 { 0.0 };
+};
+
+// Same responses as makeBandBiquad, following Simper's "Linear Trap Integrated
+// SVF" derivations. The shelves and the peak use the same definition of Q as
+// the biquads, so switching backends keeps a band's shape.
+inline SVFCoefficients makeSVFBand(BandType type, double sampleRate, double frequency, double quality, double gainFactor)
+{
+    jassert(sampleRate > 0.0);
+    jassert(quality > 0.0);
+    
+    // A squared is the gain factor, as in the biquad designs.
+    const auto A = std::sqrt(juce::jmax(1.0e-12, gainFactor));
+    const auto g = std::tan(juce::MathConstants<double>::pi * juce::jlimit(2.0, sampleRate * 0.49, frequency) / sampleRate);
+    const auto k = 1.0 / quality;
+    
+    SVFCoefficients coefficients;
+    coefficients.g = g;
+    coefficients.k = k;
+    
+    switch (type)
+    {
+        case LowShelfBand:
+            coefficients.g = g / std::sqrt(A);
+            coefficients.m1 = k * (A - 1.0);
+            coefficients.m2 = A * A - 1.0;
+            break;
+        
+        case HighShelfBand:
+            coefficients.g = g * std::sqrt(A);
+            coefficients.m0 = A * A;
+            coefficients.m1 = k * (1.0 - A) * A;
+            coefficients.m2 = 1.0 - A * A;
+            break;
+        
+        case NotchBand:
+            coefficients.m1 = -k;
+            break;
+        
+        case BandPassBand:
+            coefficients.m0 = 0.0;
+            coefficients.m1 = k;
+            break;
+        
+        // The high shelf, turned down by half its gain.
+        case TiltBand:
+            coefficients.g = g * std::sqrt(A);
+            coefficients.m0 = A;
+            coefficients.m1 = k * (1.0 - A);
+            coefficients.m2 = (1.0 - A * A) / A;
+            break;
+        
+        case PeakBand:
+        case NumBandTypes:
+        default:
+            coefficients.k = 1.0 / (quality * A);
+            coefficients.m1 = coefficients.k * (A * A - 1.0);
+            break;
+    }
+    
+    return coefficients;
+}
+
+// The filter is the bilinear transform of the analog prototype
+// H(s) = m0 + (m1 s + m2) / (s^2 + k s + 1), with the cutoff prewarped into
+// g, so evaluating the prototype at the prewarped frequency is exact.
+inline double getSVFMagnitudeForFrequency(const SVFCoefficients& coefficients, double frequency, double sampleRate)
+{
+    const auto omega = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate) / coefficients.g;
+    const std::complex<double> s(0.0, omega);
+    
+    return std::abs(coefficients.m0 + (coefficients.m1 * s + coefficients.m2) / (s * s + coefficients.k * s + 1.0));
+}
+
+// The biquad with the same response, for what only the biquads can answer
+// (such as getBiquadDecayInSamples). Not how the filter runs.
+inline BiquadCoefficients makeBiquadFromSVF(const SVFCoefficients& coefficients)
+{
+    const auto c = 1.0 / coefficients.g;
+    const auto cSquared = c * c;
+    
+    // Numerator n2 s^2 + n1 s + n0 over s^2 + k s + 1.
+    const auto n2 = coefficients.m0;
+    const auto n1 = coefficients.m0 * coefficients.k + coefficients.m1;
+    const auto n0 = coefficients.m0 + coefficients.m2;
+    
+    return makeBiquad(n2 * cSquared + n1 * c + n0,
+                      2.0 * (n0 - n2 * cSquared),
+                      n2 * cSquared - n1 * c + n0,
+                      cSquared + coefficients.k * c + 1.0,
+                      2.0 * (1.0 - cSquared),
+                      cSquared - coefficients.k * c + 1.0);
+}
+
+// A cascade of state variable filters, laid out like BiquadCascade: one array
+// per coefficient, indexed by section, and only the active sections run.
+//
+// New coefficients can be given a number of samples to get there in, over
+// which g, k and the mix move linearly, one step per sample. The integrator
+// gains are worked out from g and k again after every step, so that every
+// sample runs a filter that some positive g and k describe, which is what
+// keeps it stable. Together with redesigning every few samples that gives
+// per sample modulation for five additions and a division per sample and
+// section.
+//
+// SampleType can either be a float or a juce::dsp::SIMDRegister, in which case
+// every lane is filtered with the same coefficients.
+template<typename SampleType, int MaxSections>
+struct SVFCascade
+{
+    using NumericType = typename juce::dsp::SampleTypeHelpers::ElementType<SampleType>::Type;
+    
+    SVFCascade()
+    {
+        for (int section = 0; section < MaxSections; section++)
+        {
+            setCoefficients(section, SVFCoefficients());
+        }
+        
+        active.fill(false);
+        reset();
+    }
+    
+    void reset()
+    {
+        ic1.fill(SampleType { 0 });
+        ic2.fill(SampleType { 0 });
+    }
+    
+    // Jumps straight to the new coefficients when numSteps is 0.
+    void setCoefficients(int section, const SVFCoefficients& svf, int numSteps = 0)
+    {
+        jassert(juce::isPositiveAndBelow(section, MaxSections));
+        
+        const std::array<double, NumParameters> values { svf.g, svf.k, svf.m0, svf.m1, svf.m2 };
+        
+        for (int p = 0; p < NumParameters; p++)
+        {
+            targets[p][section] = static_cast<NumericType>(values[p]);
+            
+            if (numSteps > 0)
+            {
+                steps[p][section] = (targets[p][section] - parameters[p][section]) / static_cast<NumericType>(numSteps);
+            }
+            else
+            {
+                parameters[p][section] = targets[p][section];
+            }
+        }
+        
+        stepsRemaining[section] = juce::jmax(0, numSteps);
+        
+        if (numSteps <= 0)
+        {
+            updateIntegratorGains(section);
+        }
+    }
+    
+    void setActive(int section, bool shouldBeActive)
+    {
+        jassert(juce::isPositiveAndBelow(section, MaxSections));
+        
+        if (active[section] == shouldBeActive)
+        {
+            return;
+        }
+        
+        // A section that comes back shouldn't ring out whatever it held before.
+        if (shouldBeActive)
+        {
+            ic1[section] = SampleType { 0 };
+            ic2[section] = SampleType { 0 };
+        }
+        
+        active[section] = shouldBeActive;
+        
+        numActiveSections = 0;
+        
+        for (int i = 0; i < MaxSections; i++)
+        {
+            if (active[i])
+            {
+                activeSections[numActiveSections++] = i;
+            }
+        }
+    }
+    
+    bool isActive(int section) const { return active[section]; }
+    int getNumActiveSections() const { return numActiveSections; }
+    
+    bool hasDecayed(NumericType threshold) const noexcept
+    {
+        constexpr auto numLanes = sizeof(SampleType) / sizeof(NumericType);
+        
+        for (int i = 0; i < numActiveSections; i++)
+        {
+            auto section = activeSections[i];
+            auto* state1 = reinterpret_cast<const NumericType*>(&ic1[section]);
+            auto* state2 = reinterpret_cast<const NumericType*>(&ic2[section]);
+            
+            for (size_t lane = 0; lane < numLanes; lane++)
+            {
+                if (std::abs(state1[lane]) > threshold || std::abs(state2[lane]) > threshold)
+                {
+                    return false;
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    void process(SampleType* samples, size_t numSamples) noexcept
+    {
+        for (size_t n = 0; n < numSamples; n++)
+        {
+            auto x = samples[n];
+            
+            for (int i = 0; i < numActiveSections; i++)
+            {
+                const auto section = activeSections[i];
+                
+                if (stepsRemaining[section] > 0)
+                {
+                    step(section);
+                }
+                
+                const auto v3 = x - ic2[section];
+                const auto v1 = (ic1[section] * a1[section]) + (v3 * a2[section]);
+                const auto v2 = ic2[section] + (ic1[section] * a2[section]) + (v3 * a3[section]);
+                
+                ic1[section] = v1 + v1 - ic1[section];
+                ic2[section] = v2 + v2 - ic2[section];
+                
+                x = (x * parameters[M0][section]) + (v1 * parameters[M1][section]) + (v2 * parameters[M2][section]);
+            }
+            
+            samples[n] = x;
+        }
+        
+        for (int i = 0; i < numActiveSections; i++)
+        {
+            juce::dsp::util::snapToZero(ic1[activeSections[i]]);
+            juce::dsp::util::snapToZero(ic2[activeSections[i]]);
+        }
+    }
+    
+private:
+    // What glides. The integrator gains are derived from G and K.
+    enum Parameter
+    {
+        G,
+        K,
+        M0,
+        M1,
+        M2,
+        NumParameters
+    };
+    
+    using SectionValues = std::array<NumericType, MaxSections>;
+    
+    std::array<SectionValues, NumParameters> parameters, targets, steps;
+    std::array<int, MaxSections> stepsRemaining {};
+    SectionValues a1, a2, a3;
+    
+    std::array<SampleType, MaxSections> ic1, ic2;
+    
+    std::array<bool, MaxSections> active;
+    std::array<int, MaxSections> activeSections;
+    int numActiveSections = 0;
+    
+    void step(int section) noexcept
+    {
+        // The last step lands exactly on the target, rounding errors and all.
+        const auto isLast = --stepsRemaining[section] == 0;
+        
+        for (int p = 0; p < NumParameters; p++)
+        {
+            parameters[p][section] = isLast ? targets[p][section] : parameters[p][section] + steps[p][section];
+        }
+        
+        updateIntegratorGains(section);
+    }
+    
+    void updateIntegratorGains(int section) noexcept
+    {
+        const auto g = static_cast<double>(parameters[G][section]);
+        const auto k = static_cast<double>(parameters[K][section]);
+        const auto gain1 = 1.0 / (1.0 + g * (g + k));
+        
+        a1[section] = static_cast<NumericType>(gain1);
+        a2[section] = static_cast<NumericType>(g * gain1);
+        a3[section] = static_cast<NumericType>(g * g * gain1);
+    }
+};
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    SharedResources.cpp
+
+  ==============================================================================
+*/
+
+#include "SharedResources.h"
+
+const AnalyzerResources::Entry& AnalyzerResources::getEntry(int order)
+{
+    jassert(order >= MinOrder && order <= MaxOrder);
+    
+    auto& entry = entries[(size_t) juce::jlimit(MinOrder, MaxOrder, order) - MinOrder];
+    
+    const juce::ScopedLock sl(lock);
+    
+    if (entry.fft == nullptr)
+    {
+        const auto size = (size_t) 1 << order;
+        
+        entry.fft = std::make_unique<juce::dsp::FFT>(order);
+        entry.window = std::make_unique<juce::dsp::WindowingFunction<float>>(size, juce::dsp::WindowingFunction<float>::blackmanHarris);
+    }
+    
+    return entry;
+}
+
+const juce::dsp::FFT& AnalyzerResources::getFFT(int order)
+{
+    return *getEntry(order).fft;
+}
+
+const juce::dsp::WindowingFunction<float>& AnalyzerResources::getWindow(int order)
+{
+    return *getEntry(order).window;
+}
+
+//==============================================================================
+
+juce::Image GridImageCache::getImage(int width, int height, float scale, const Renderer& render)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    if (width <= 0 || height <= 0)
+    {
+        return {};
+    }
+    
+    for (const auto& entry : entries)
+    {
+        if (entry.width == width && entry.height == height && entry.scale == scale)
+        {
+            return entry.image;
+        }
+    }
+    
+    if ((int) entries.size() >= MaxImages)
+    {
+        entries.erase(std::remove_if(entries.begin(),
+                                     entries.end(),
+                                     [](const Entry& entry) { return entry.image.getReferenceCount() <= 1; }),
+                      entries.end());
+    }
+    
+    Entry entry;
+    entry.width = width;
+    entry.height = height;
+    entry.scale = scale;
+    entry.image = juce::Image(juce::Image::PixelFormat::RGB,
+                              juce::roundToInt((float) width * scale),
+                              juce::roundToInt((float) height * scale),
+                              true);
+    
+    {
+        juce::Graphics g(entry.image);
+        g.addTransform(juce::AffineTransform::scale(scale));
+        render(g);
+    }
+    
+    entries.push_back(entry);
+    
+    return entry.image;
+}
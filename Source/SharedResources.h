@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    SharedResources.h
+    Immutable resources that every SimpleEQ instance in the process can use,
+    built once and held through juce::SharedResourcePointer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// FFT plans and window tables for the analyzer, by FFT order. Every order gets
+// built on first use and kept until the last instance goes away. The windows
+// never change once built, but some FFT engines keep their working buffers in
+// the plan, so transforms may only run on the shared AnalyzerThread, which
+// runs them one at a time. PathProducer::process asserts that.
+struct AnalyzerResources
+{
+    static constexpr int MinOrder = 11;
+    static constexpr int MaxOrder = 13;
+    
+    // Not realtime safe the first time an order is asked for.
+    const juce::dsp::FFT& getFFT(int order);
+    const juce::dsp::WindowingFunction<float>& getWindow(int order);
+    
+private:
+    struct Entry
+    {
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    };
+    
+    juce::CriticalSection lock;
+    std::array<Entry, MaxOrder - MinOrder + 1> entries;
+    
+    const Entry& getEntry(int order);
+};
+
+// The typeface the editor draws its text with, looked up once per process
+// instead of on every paint call. Message thread only.
+struct EditorFonts
+{
+    juce::Font getFont(float height) const { return juce::Font(typeface).withHeight(height); }
+    
+private:
+    juce::Typeface::Ptr typeface { juce::Font().getTypefacePtr() };
+};
+
+// Backgrounds that only depend on the size of a component and the scale it is
+// shown at, such as the grid of the response curve. Editors of the same size
+// get the same image, it is only rendered once. Message thread only.
+struct GridImageCache
+{
+    using Renderer = std::function<void(juce::Graphics&)>;
+    
+    // Renders into an image of width * scale by height * scale pixels, through
+    // a transform that lets render draw in component coordinates.
+    juce::Image getImage(int width, int height, float scale, const Renderer& render);
+    
+private:
+    // Only images no editor holds on to anymore get evicted.
+    static constexpr int MaxImages = 8;
+    
+    struct Entry
+    {
+        int width { 0 }, height { 0 };
+        float scale { 1.f };
+        juce::Image image;
+    };
+    
+    std::vector<Entry> entries;
+};
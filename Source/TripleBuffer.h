@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    TripleBuffer.h
+    Lock-free handoff of the newest value from one thread to another.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Single producer / single consumer handoff that always delivers the newest
+// value. The producer writes into its own slot and swaps it with the shared
+// one; the consumer swaps the shared slot with its own when something new was
+// published. Neither side ever blocks or allocates.
+template<typename T>
+struct TripleBuffer
+{
+    T& getWriteBuffer() { return buffers[writeIndex]; }
+    
+    void publish()
+    {
+        auto previous = middle.exchange(writeIndex | NewDataFlag);
+        writeIndex = previous & IndexMask;
+    }
+    
+    // Consumer only. Whether pull() would return true, without swapping.
+    bool hasNewData() const { return (middle.get() & NewDataFlag) != 0; }
+    
+    bool pull()
+    {
+        if (!hasNewData())
+        {
+            return false;
+        }
+        
+        auto previous = middle.exchange(readIndex);
+        readIndex = previous & IndexMask;
+        return true;
+    }
+    
+    const T& getReadBuffer() const { return buffers[readIndex]; }
+    
+private:
+    static constexpr int IndexMask = 3;
+    static constexpr int NewDataFlag = 4;
+    
+    std::array<T, 3> buffers;
+    int writeIndex = 0;
+    int readIndex = 2;
+    juce::Atomic<int> middle { 1 };
+};
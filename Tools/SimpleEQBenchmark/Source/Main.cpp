@@ -0,0 +1,509 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Times the hot paths of SimpleEQ and prints the results as JSON, so that
+    runs can be compared across releases. processBlock is also measured for
+    the original MonoChain processing, as a baseline for the fused engine.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/PluginEditor.h"
+
+static double minimumSecondsPerCase = 0.2;
+
+// Calls function until at least minimumSecondsPerCase have passed and returns
+// the average time per call in nanoseconds.
+template<typename Function>
+static double timeCalls(Function&& function)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        function();
+    }
+    
+    const auto minimumTicks = juce::Time::secondsToHighResolutionTicks(minimumSecondsPerCase);
+    const auto start = juce::Time::getHighResolutionTicks();
+    
+    juce::int64 numCalls = 0, elapsedTicks = 0;
+    
+    for (int batchSize = 1;; batchSize = juce::jmin(batchSize * 2, 1 << 16))
+    {
+        for (int i = 0; i < batchSize; i++)
+        {
+            function();
+        }
+        
+        numCalls += batchSize;
+        elapsedTicks = juce::Time::getHighResolutionTicks() - start;
+        
+        if (elapsedTicks >= minimumTicks)
+        {
+            break;
+        }
+    }
+    
+    return juce::Time::highResolutionTicksToSeconds(elapsedTicks) * 1.0e9 / (double) numCalls;
+}
+
+static void setParameter(SimpleEQAudioProcessor& processor, const juce::String& parameterID, float value)
+{
+    auto* parameter = processor.apvts.getParameter(parameterID);
+    jassert(parameter != nullptr);
+    
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+// A typical setting with every band doing something, so that nothing gets
+// elided.
+static void setUpParameters(SimpleEQAudioProcessor& processor, Slope slope)
+{
+    setParameter(processor, "LowCut Freq", 80.f);
+    setParameter(processor, "HighCut Freq", 12000.f);
+    setParameter(processor, "Peak Freq", 1000.f);
+    setParameter(processor, "Peak Gain", 6.f);
+    setParameter(processor, "Peak Quality", 1.f);
+    
+    // The steep slopes override the original ones.
+    const auto isSteep = slope >= Slope::NumOriginalSlopes;
+    const auto originalSlope = isSteep ? Slope::Slope_48 : slope;
+    const auto steepSlope = isSteep ? slope - Slope::NumOriginalSlopes + 1 : 0;
+    
+    for (auto cut : { "LowCut", "HighCut" })
+    {
+        setParameter(processor, juce::String(cut) + " Slope", (float) originalSlope);
+        setParameter(processor, juce::String(cut) + " Steep Slope", (float) steepSlope);
+    }
+}
+
+static void fillWithNoise(juce::AudioBuffer<float>& buffer)
+{
+    juce::Random random(0x5eed);
+    
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+    {
+        for (int i = 0; i < buffer.getNumSamples(); i++)
+        {
+            buffer.setSample(channel, i, random.nextFloat() * 2.f - 1.f);
+        }
+    }
+}
+
+// The processing this project started out with: one MonoChain per channel,
+// redesigned from the parameters on every block. It only goes up to 48 dB/oct.
+namespace Baseline
+{
+    using Filter = juce::dsp::IIR::Filter<float>;
+    using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+    using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+    using Coefficients = Filter::CoefficientsPtr;
+    
+    enum ChainPositions
+    {
+        LowCut,
+        Peak,
+        HighCut
+    };
+    
+    static bool supportsSlope(Slope slope)
+    {
+        return slope <= Slope_48;
+    }
+    
+    static void updateCoefficients(Coefficients& old, const Coefficients& replacements)
+    {
+        *old = *replacements;
+    }
+    
+    template<int Index, typename ChainType, typename CoefficientType>
+    void updateCutCoefficients(ChainType& chain, const CoefficientType& coefficients)
+    {
+        updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
+        chain.template setBypassed<Index>(false);
+    }
+    
+    template<typename ChainType, typename CoefficientType>
+    void updateCutCoefficients(ChainType& chain, const CoefficientType& coefficients, const Slope& slope)
+    {
+        chain.template setBypassed<0>(true);
+        chain.template setBypassed<1>(true);
+        chain.template setBypassed<2>(true);
+        chain.template setBypassed<3>(true);
+        
+        switch (slope)
+        {
+            case Slope_48:
+                updateCutCoefficients<3>(chain, coefficients);
+            case Slope_36:
+                updateCutCoefficients<2>(chain, coefficients);
+            case Slope_24:
+                updateCutCoefficients<1>(chain, coefficients);
+            case Slope_12:
+                updateCutCoefficients<0>(chain, coefficients);
+                break;
+            default:
+                jassertfalse;
+                break;
+        }
+    }
+    
+    static Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+    {
+        return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
+                                                                   chainSettings.bands[0].freq,
+                                                                   chainSettings.bands[0].quality,
+                                                                   juce::Decibels::decibelsToGain(chainSettings.bands[0].gainDecibels));
+    }
+    
+    static auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+    {
+        return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
+                                                                                           sampleRate,
+                                                                                           getSlopeOrder(chainSettings.lowCutSlope));
+    }
+    
+    static auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+    {
+        return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
+                                                                                          sampleRate,
+                                                                                          getSlopeOrder(chainSettings.highCutSlope));
+    }
+}
+
+struct MonoChainBaseline
+{
+    void prepare(double sampleRate, int samplesPerBlock)
+    {
+        juce::dsp::ProcessSpec spec;
+        spec.maximumBlockSize = samplesPerBlock;
+        spec.numChannels = 1;
+        spec.sampleRate = sampleRate;
+        
+        leftChain.prepare(spec);
+        rightChain.prepare(spec);
+        
+        currentSampleRate = sampleRate;
+    }
+    
+    void updateFilters(juce::AudioProcessorValueTreeState& apvts)
+    {
+        using namespace Baseline;
+        
+        auto chainSettings = getChainSettings(apvts);
+        
+        auto peakCoefficients = makePeakFilter(chainSettings, currentSampleRate);
+        auto lowCutCoefficients = makeLowCutFilter(chainSettings, currentSampleRate);
+        auto highCutCoefficients = makeHighCutFilter(chainSettings, currentSampleRate);
+        
+        for (auto* chain : { &leftChain, &rightChain })
+        {
+            chain->setBypassed<ChainPositions::Peak>(chainSettings.bands[0].bypassed);
+            chain->setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+            chain->setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+            
+            updateCoefficients(chain->get<ChainPositions::Peak>().coefficients, peakCoefficients);
+            updateCutCoefficients(chain->get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
+            updateCutCoefficients(chain->get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+        }
+    }
+    
+    void process(juce::AudioBuffer<float>& buffer, juce::AudioProcessorValueTreeState& apvts)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        
+        updateFilters(apvts);
+        
+        juce::dsp::AudioBlock<float> block(buffer);
+        
+        auto leftBlock = block.getSingleChannelBlock(0);
+        auto rightBlock = block.getSingleChannelBlock(1);
+        
+        leftChain.process(juce::dsp::ProcessContextReplacing<float>(leftBlock));
+        rightChain.process(juce::dsp::ProcessContextReplacing<float>(rightBlock));
+    }
+    
+    Baseline::MonoChain leftChain, rightChain;
+    double currentSampleRate { 44100.0 };
+};
+
+static juce::var makeResult(const juce::String& benchmark, double nanosecondsPerCall)
+{
+    auto* result = new juce::DynamicObject();
+    result->setProperty("benchmark", benchmark);
+    result->setProperty("nsPerCall", nanosecondsPerCall);
+    
+    return juce::var(result);
+}
+
+static void benchmarkProcessBlock(juce::Array<juce::var>& results)
+{
+    const std::initializer_list<double> sampleRates { 44100.0, 48000.0, 96000.0, 192000.0 };
+    
+    for (auto sampleRate : sampleRates)
+    {
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= 2)
+        {
+            juce::AudioBuffer<float> noise(2, blockSize), buffer(2, blockSize);
+            juce::MidiBuffer midiMessages;
+            fillWithNoise(noise);
+            
+            for (int i = 0; i < Slope::NumSlopes; i++)
+            {
+                const auto slope = static_cast<Slope>(i);
+                
+                SimpleEQAudioProcessor processor;
+                setUpParameters(processor, slope);
+                
+                processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+                processor.prepareToPlay(sampleRate, blockSize);
+                
+                MonoChainBaseline baseline;
+                baseline.prepare(sampleRate, blockSize);
+                
+                // Both copy fresh input in first, so that the signal stays the same.
+                auto engineTime = timeCalls([&]
+                {
+                    buffer.makeCopyOf(noise, true);
+                    processor.processBlock(buffer, midiMessages);
+                });
+                
+                std::vector<std::pair<const char*, double>> times { { "SimpleEQ", engineTime } };
+                
+                if (Baseline::supportsSlope(slope))
+                {
+                    times.push_back({ "MonoChain", timeCalls([&]
+                    {
+                        buffer.makeCopyOf(noise, true);
+                        baseline.process(buffer, processor.apvts);
+                    }) });
+                }
+                
+                processor.releaseResources();
+                
+                for (auto [engine, time] : times)
+                {
+                    auto result = makeResult("processBlock", time);
+                    auto* object = result.getDynamicObject();
+                    object->setProperty("engine", engine);
+                    object->setProperty("sampleRate", sampleRate);
+                    object->setProperty("blockSize", blockSize);
+                    object->setProperty("slope", getSlopeDecibelsPerOctave(slope));
+                    object->setProperty("nsPerSample", time / blockSize);
+                    object->setProperty("realtimeFactor", (blockSize / sampleRate) * 1.0e9 / time);
+                    results.add(result);
+                }
+            }
+        }
+    }
+}
+
+static void benchmarkFilterUpdates(juce::Array<juce::var>& results)
+{
+    SimpleEQAudioProcessor processor;
+    setUpParameters(processor, Slope::Slope_48);
+    
+    const auto sampleRate = 48000.0;
+    auto chainSettings = getChainSettings(processor.apvts);
+    
+    results.add(makeResult("getChainSettings", timeCalls([&]
+    {
+        chainSettings = getChainSettings(processor.apvts);
+    })));
+    
+    // What the design thread does when every band has changed.
+    auto chainCoefficients = makeChainCoefficients(chainSettings, sampleRate);
+    
+    results.add(makeResult("makeChainCoefficients", timeCalls([&]
+    {
+        chainCoefficients = makeChainCoefficients(chainSettings, sampleRate);
+    })));
+    
+    // The same through the coefficient cache, which after the first call hits.
+    CoefficientCache cache;
+    
+    results.add(makeResult("makeChainCoefficients (cached)", timeCalls([&]
+    {
+        chainCoefficients = makeChainCoefficients(chainSettings, sampleRate, &cache);
+    })));
+    
+    // What updateFilters does on the audio thread once coefficients arrive.
+    FilterStage<float> filters;
+    filters.prepare({ sampleRate, 512, 2 });
+    
+    StereoChainCoefficients stereoCoefficients;
+    stereoCoefficients.main = chainCoefficients;
+    
+    results.add(makeResult("FilterStage::setCoefficients", timeCalls([&]
+    {
+        // Bumping the versions makes every band count as changed.
+        for (auto& version : stereoCoefficients.main.bandVersions)
+        {
+            version++;
+        }
+        
+        stereoCoefficients.main.lowCutVersion++;
+        stereoCoefficients.main.highCutVersion++;
+        
+        filters.setCoefficients(stereoCoefficients);
+    })));
+    
+    // What updateFilters used to do on every block.
+    MonoChainBaseline baseline;
+    baseline.prepare(sampleRate, 512);
+    
+    results.add(makeResult("MonoChain::updateFilters", timeCalls([&]
+    {
+        baseline.updateFilters(processor.apvts);
+    })));
+}
+
+static void benchmarkAnalyzer(juce::Array<juce::var>& results)
+{
+    const auto negativeInfinity = -48.f;
+    
+    for (auto order : { FFTOrder::order2048, FFTOrder::order4096, FFTOrder::order8192 })
+    {
+        FFTDataGenerator<std::vector<float>> generator;
+        generator.changeOrder(order);
+        
+        juce::AudioBuffer<float> audioData(1, generator.getFFTSize());
+        fillWithNoise(audioData);
+        
+        std::vector<float> fftData;
+        
+        auto time = timeCalls([&]
+        {
+            generator.produceFFTDataForRendering(audioData, negativeInfinity);
+            
+            // Keep the FIFO from filling up.
+            generator.getFFTData(fftData);
+        });
+        
+        auto result = makeResult("FFTDataGenerator::produceFFTDataForRendering", time);
+        result.getDynamicObject()->setProperty("fftOrder", (int) order);
+        results.add(result);
+        
+        for (auto width : { 256, 512, 1024, 2048 })
+        {
+            AnalyzerPathGenerator<juce::Path> pathGenerator;
+            juce::Path path;
+            
+            const auto fftSize = generator.getFFTSize();
+            const auto binWidth = 48000.f / (float) fftSize;
+            const juce::Rectangle<float> bounds(0.f, 0.f, (float) width, 300.f);
+            
+            auto pathTime = timeCalls([&]
+            {
+                pathGenerator.generatePath(fftData, bounds, fftSize, binWidth, negativeInfinity);
+                pathGenerator.getPath(path);
+            });
+            
+            auto pathResult = makeResult("AnalyzerPathGenerator::generatePath", pathTime);
+            pathResult.getDynamicObject()->setProperty("fftOrder", (int) order);
+            pathResult.getDynamicObject()->setProperty("width", width);
+            results.add(pathResult);
+        }
+    }
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: SimpleEQBenchmark [--output <file>] [--min-time <seconds per case>]" << std::endl
+              << "                         [--only processBlock|updates|analyzer] [--require-realtime-safe]" << std::endl
+              << std::endl
+              << "--require-realtime-safe fails the run if processBlock allocated or locked, which" << std::endl
+              << "needs a build with SIMPLEEQ_ENABLE_REALTIME_CHECKS=1." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    // The processors' parameters and value trees expect a message manager.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    juce::ArgumentList args(argc, argv);
+    
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+    
+    auto minimumTime = args.removeValueForOption("--min-time");
+    
+    if (minimumTime.isNotEmpty())
+    {
+        minimumSecondsPerCase = juce::jmax(0.001, minimumTime.getDoubleValue());
+    }
+    
+    auto only = args.removeValueForOption("--only");
+    auto outputPath = args.removeValueForOption("--output");
+    auto requireRealtimeSafe = args.containsOption("--require-realtime-safe");
+    
+    juce::Array<juce::var> results;
+    
+    RealtimeChecker::reset();
+    
+    if (only.isEmpty() || only == "processBlock")
+    {
+        benchmarkProcessBlock(results);
+    }
+    
+    if (only.isEmpty() || only == "updates")
+    {
+        benchmarkFilterUpdates(results);
+    }
+    
+    if (only.isEmpty() || only == "analyzer")
+    {
+        benchmarkAnalyzer(results);
+    }
+    
+    auto* root = new juce::DynamicObject();
+    root->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+    root->setProperty("juceVersion", juce::SystemStats::getJUCEVersion());
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("numCpus", juce::SystemStats::getNumCpus());
+    root->setProperty("simdFloatLanes", (int) juce::dsp::SIMDRegister<float>::size());
+    root->setProperty("minimumSecondsPerCase", minimumSecondsPerCase);
+    root->setProperty("results", results);
+    
+    auto numViolations = RealtimeChecker::getNumViolations();
+    
+    auto* realtimeChecks = new juce::DynamicObject();
+    realtimeChecks->setProperty("enabled", RealtimeChecker::isEnabled());
+    realtimeChecks->setProperty("allocations", RealtimeChecker::getNumViolations(RealtimeChecker::Allocation));
+    realtimeChecks->setProperty("deallocations", RealtimeChecker::getNumViolations(RealtimeChecker::Deallocation));
+    realtimeChecks->setProperty("locks", RealtimeChecker::getNumViolations(RealtimeChecker::Lock));
+    root->setProperty("realtimeChecks", juce::var(realtimeChecks));
+    
+    RealtimeChecker::Violation violation;
+    
+    for (int i = 0; RealtimeChecker::getViolation(i, violation); i++)
+    {
+        std::cerr << RealtimeChecker::describe(violation) << std::endl;
+    }
+    
+    auto json = juce::JSON::toString(juce::var(root));
+    
+    if (outputPath.isEmpty())
+    {
+        std::cout << json << std::endl;
+    }
+    else if (!juce::File::getCurrentWorkingDirectory().getChildFile(outputPath).replaceWithText(json))
+    {
+        std::cerr << "Can't write " << outputPath << std::endl;
+        return 1;
+    }
+    
+    if (requireRealtimeSafe && (!RealtimeChecker::isEnabled() || numViolations > 0))
+    {
+        std::cerr << (RealtimeChecker::isEnabled() ? juce::String(numViolations) + " realtime violations"
+                                                   : juce::String("Realtime checks aren't enabled in this build")) << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
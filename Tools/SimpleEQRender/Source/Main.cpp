@@ -0,0 +1,323 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Renders audio files through SimpleEQAudioProcessor without a host or an
+    editor. Files are spread over a set of worker threads, each of which owns
+    its own processor.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+struct RenderSettings
+{
+    juce::MemoryBlock state;
+    juce::File outputDirectory;
+    juce::String format; // File extension, or empty to keep the input format.
+    int blockSize { 8192 };
+};
+
+// The files left to render. Workers claim the next one as soon as they are
+// done with the last, so a few long files don't hold up everything else.
+struct RenderQueue
+{
+    juce::Array<juce::File> files;
+    juce::Atomic<int> nextFile { 0 };
+    
+    bool claim(juce::File& file)
+    {
+        auto index = ++nextFile - 1;
+        
+        if (index >= files.size())
+        {
+            return false;
+        }
+        
+        file = files[index];
+        return true;
+    }
+};
+
+static juce::CriticalSection outputLock;
+
+static void print(const juce::String& text)
+{
+    const juce::ScopedLock sl(outputLock);
+    std::cout << text << std::endl;
+}
+
+// Streams one file through the processor. The latency of the processor is
+// compensated, so the output lines up with the input and has the same length.
+static juce::Result renderFile(SimpleEQAudioProcessor& processor,
+                               juce::AudioFormatManager& formatManager,
+                               const juce::File& inputFile,
+                               const RenderSettings& settings,
+                               juce::File& outputFile,
+                               double& lengthInSeconds)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+    
+    if (reader == nullptr)
+    {
+        return juce::Result::fail("Can't read " + inputFile.getFullPathName());
+    }
+    
+    const auto numChannels = (int) reader->numChannels;
+    const auto sampleRate = reader->sampleRate;
+    const auto blockSize = settings.blockSize;
+    
+    // Only the main buses follow the file, the sidechain stays off so the
+    // detector listens to the band's own input.
+    auto layout = processor.getBusesLayout();
+    layout.inputBuses.getReference(0) = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+    layout.outputBuses.getReference(0) = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+    
+    for (int bus = 1; bus < layout.inputBuses.size(); ++bus)
+    {
+        layout.inputBuses.getReference(bus) = juce::AudioChannelSet::disabled();
+    }
+    
+    if (!processor.setBusesLayout(layout))
+    {
+        return juce::Result::fail(juce::String(numChannels) + " channels aren't supported");
+    }
+    
+    auto extension = settings.format.isEmpty() ? inputFile.getFileExtension() : "." + settings.format;
+    auto* format = formatManager.findFormatForFileExtension(extension);
+    
+    if (format == nullptr)
+    {
+        return juce::Result::fail("Can't write " + extension + " files");
+    }
+    
+    auto bitDepths = format->getPossibleBitDepths();
+    auto bitsPerSample = bitDepths.contains((int) reader->bitsPerSample) ? (int) reader->bitsPerSample
+                                                                          : bitDepths.getLast();
+    
+    outputFile = settings.outputDirectory.getChildFile(inputFile.getFileNameWithoutExtension())
+                                         .withFileExtension(extension);
+    outputFile.deleteFile();
+    
+    auto stream = outputFile.createOutputStream();
+    
+    if (stream == nullptr)
+    {
+        return juce::Result::fail("Can't create " + outputFile.getFullPathName());
+    }
+    
+    std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(),
+                                                                            sampleRate,
+                                                                            (unsigned int) numChannels,
+                                                                            bitsPerSample,
+                                                                            reader->metadataValues,
+                                                                            0));
+    
+    if (writer == nullptr)
+    {
+        return juce::Result::fail("Can't write " + outputFile.getFullPathName() + " with " + juce::String(numChannels) + " channels");
+    }
+    
+    // The writer owns the stream now.
+    stream.release();
+    
+    processor.setNonRealtime(true);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+    
+    const auto length = reader->lengthInSamples;
+    juce::int64 samplesToDrop = processor.getLatencySamples();
+    juce::int64 readPosition = 0, writePosition = 0;
+    
+    juce::AudioBuffer<float> buffer(numChannels, blockSize);
+    juce::MidiBuffer midiMessages;
+    
+    while (writePosition < length)
+    {
+        // Past the end of the input, silence flushes out the latency.
+        buffer.clear();
+        
+        auto numToRead = (int) juce::jlimit((juce::int64) 0, (juce::int64) blockSize, length - readPosition);
+        
+        if (numToRead > 0)
+        {
+            reader->read(&buffer, 0, numToRead, readPosition, true, true);
+            readPosition += numToRead;
+        }
+        
+        processor.processBlock(buffer, midiMessages);
+        
+        auto start = (int) juce::jmin(samplesToDrop, (juce::int64) blockSize);
+        samplesToDrop -= start;
+        
+        auto numToWrite = (int) juce::jmin((juce::int64) (blockSize - start), length - writePosition);
+        
+        if (numToWrite > 0 && !writer->writeFromAudioSampleBuffer(buffer, start, numToWrite))
+        {
+            processor.releaseResources();
+            return juce::Result::fail("Failed writing " + outputFile.getFullPathName());
+        }
+        
+        writePosition += juce::jmax(0, numToWrite);
+    }
+    
+    processor.releaseResources();
+    
+    lengthInSeconds = (double) length / sampleRate;
+    
+    return juce::Result::ok();
+}
+
+struct RenderWorker : juce::Thread
+{
+    RenderWorker(RenderQueue& q, const RenderSettings& s, int index) :
+    juce::Thread("SimpleEQ Render " + juce::String(index)),
+    queue(q),
+    settings(s)
+    {
+        formatManager.registerBasicFormats();
+        
+        processor.setStateInformation(settings.state.getData(), (int) settings.state.getSize());
+    }
+    
+    void run() override
+    {
+        juce::File inputFile;
+        
+        while (!threadShouldExit() && queue.claim(inputFile))
+        {
+            juce::File outputFile;
+            auto lengthInSeconds = 0.0;
+            
+            auto startTime = juce::Time::getMillisecondCounterHiRes();
+            auto result = renderFile(processor, formatManager, inputFile, settings, outputFile, lengthInSeconds);
+            auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+            
+            if (result.failed())
+            {
+                print(inputFile.getFileName() + ": " + result.getErrorMessage());
+                ++numFailed;
+                continue;
+            }
+            
+            print(inputFile.getFileName() + " -> " + outputFile.getFullPathName() + ": "
+                  + juce::String(lengthInSeconds, 1) + " s in " + juce::String(elapsedSeconds, 2) + " s ("
+                  + juce::String(lengthInSeconds / juce::jmax(elapsedSeconds, 1.0e-6), 1) + "x realtime)");
+            
+            renderedSeconds += lengthInSeconds;
+        }
+    }
+    
+    RenderQueue& queue;
+    const RenderSettings& settings;
+    
+    juce::AudioFormatManager formatManager;
+    SimpleEQAudioProcessor processor;
+    
+    double renderedSeconds { 0.0 };
+    int numFailed { 0 };
+};
+
+static void printUsage()
+{
+    std::cout << "Usage: SimpleEQRender --state <file> [--output <directory>] [--format wav|flac]" << std::endl
+              << "                      [--threads <count>] [--block-size <samples>] <input files...>" << std::endl
+              << std::endl
+              << "The state file holds what SimpleEQ saves with getStateInformation." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    // The processors' parameters and value trees expect a message manager.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    juce::ArgumentList args(argc, argv);
+    
+    if (args.size() == 0 || args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+    
+    RenderSettings settings;
+    
+    auto stateFile = juce::File::getCurrentWorkingDirectory().getChildFile(args.removeValueForOption("--state"));
+    
+    if (!stateFile.existsAsFile() || !stateFile.loadFileAsData(settings.state))
+    {
+        std::cerr << "Can't load the state from " << stateFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    
+    auto outputDirectory = args.removeValueForOption("--output");
+    settings.outputDirectory = outputDirectory.isEmpty() ? juce::File::getCurrentWorkingDirectory()
+                                                         : juce::File::getCurrentWorkingDirectory().getChildFile(outputDirectory);
+    
+    if (!settings.outputDirectory.createDirectory())
+    {
+        std::cerr << "Can't create " << settings.outputDirectory.getFullPathName() << std::endl;
+        return 1;
+    }
+    
+    settings.format = args.removeValueForOption("--format").trimCharactersAtStart(".").toLowerCase();
+    
+    auto blockSize = args.removeValueForOption("--block-size");
+    settings.blockSize = blockSize.isEmpty() ? settings.blockSize : juce::jmax(16, blockSize.getIntValue());
+    
+    auto threads = args.removeValueForOption("--threads");
+    auto numThreads = threads.isEmpty() ? juce::SystemStats::getNumCpus() : juce::jmax(1, threads.getIntValue());
+    
+    RenderQueue queue;
+    
+    for (auto& argument : args.arguments)
+    {
+        auto file = argument.resolveAsFile();
+        
+        if (!file.existsAsFile())
+        {
+            std::cerr << "No such file: " << argument.text << std::endl;
+            return 1;
+        }
+        
+        queue.files.add(file);
+    }
+    
+    numThreads = juce::jmin(numThreads, queue.files.size());
+    
+    // Every processor is created and loaded here, the workers only render.
+    juce::OwnedArray<RenderWorker> workers;
+    
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers.add(new RenderWorker(queue, settings, i));
+    }
+    
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+    
+    for (auto* worker : workers)
+    {
+        worker->startThread();
+    }
+    
+    auto renderedSeconds = 0.0;
+    auto numFailed = 0;
+    
+    for (auto* worker : workers)
+    {
+        worker->waitForThreadToExit(-1);
+        
+        renderedSeconds += worker->renderedSeconds;
+        numFailed += worker->numFailed;
+    }
+    
+    auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+    
+    print("Rendered " + juce::String(queue.files.size() - numFailed) + " of " + juce::String(queue.files.size())
+          + " files, " + juce::String(renderedSeconds, 1) + " s of audio in " + juce::String(elapsedSeconds, 2) + " s ("
+          + juce::String(renderedSeconds / juce::jmax(elapsedSeconds, 1.0e-6), 1) + "x realtime) on "
+          + juce::String(numThreads) + " threads");
+    
+    return numFailed == 0 ? 0 : 1;
+}